@@ -0,0 +1,82 @@
+#include "window.h"
+#include "blur_effect.h"
+#include "gaussian_kernel.h"
+
+#include <GL/glew.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Times blur_effect over a range of sigmas with both backends and prints a table: the
+// taps of each pass, the fetches the fragment backend makes for them and the GPU time
+// of a full (both directions) in place blur. Run with 11, 16 or 32 as the argument to
+// blur R11F_G11F_B10F, RGBA16F or RGBA32F framebuffers instead of RGBA8.
+
+namespace {
+
+constexpr auto FramebufferSize = 1024;
+constexpr auto WarmupIterations = 4;
+constexpr auto Iterations = 64;
+constexpr float Sigmas[] = { 1.0f, 1.8f, 2.5f, 4.0f, 6.0f, 8.0f, 12.0f, 16.0f, 24.0f, 32.0f, 48.0f };
+
+// microseconds per blur
+double time_blur(const gl::blur_effect &blur, float sigma)
+{
+    for (int i = 0; i < WarmupIterations; ++i)
+        blur.blur_gaussian(sigma);
+
+    GLuint query;
+    glGenQueries(1, &query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int i = 0; i < Iterations; ++i)
+        blur.blur_gaussian(sigma);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    glDeleteQueries(1, &query);
+
+    return elapsed / (1000.0 * Iterations);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    auto internal_format = GL_RGBA8;
+    const char *format_name = "RGBA8";
+    const auto bits = argc > 1 ? std::atoi(argv[1]) : 8;
+    if (bits == 11) {
+        internal_format = GL_R11F_G11F_B10F;
+        format_name = "R11F_G11F_B10F";
+    } else if (bits == 16) {
+        internal_format = GL_RGBA16F;
+        format_name = "RGBA16F";
+    } else if (bits == 32) {
+        internal_format = GL_RGBA32F;
+        format_name = "RGBA32F";
+    }
+
+    gl::window w(256, 256, "blur-bench");
+
+    gl::blur_effect fragment_blur(FramebufferSize, FramebufferSize, internal_format, 1, gl::blur_backend::fragment);
+    gl::blur_effect compute_blur(FramebufferSize, FramebufferSize, internal_format, 1, gl::blur_backend::compute);
+
+    std::printf("%dx%d %s\n", FramebufferSize, FramebufferSize, format_name);
+    std::printf("%8s %8s %8s %8s %12s %12s\n", "sigma", "passes", "taps", "fetches", "fragment us", "compute us");
+
+    for (auto sigma : Sigmas) {
+        const auto passes = gl::blur_effect::pass_count(sigma);
+        const auto weights = gl::gaussian_weights(sigma / std::sqrt(static_cast<float>(passes)),
+                                                  gl::blur_effect::MaxKernelRadius);
+        const int taps = 2 * weights.size() - 1;
+        const int fetches = 2 * gl::linear_taps(weights).size() - 1;
+
+        const auto fragment_time = time_blur(fragment_blur, sigma);
+        const auto compute_time = time_blur(compute_blur, sigma);
+
+        std::printf("%8.1f %8d %8d %8d %12.1f %12.1f\n", sigma, passes, taps, fetches, fragment_time, compute_time);
+        std::fflush(stdout);
+    }
+}
@@ -0,0 +1,96 @@
+#include "antialiasing.h"
+
+#include "framebuffer.h"
+#include "render_target_pool.h"
+#include "panic.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace gl {
+
+antialiasing_settings antialiasing_settings::parse(const char *name)
+{
+    if (std::strcmp(name, "off") == 0)
+        return { antialiasing_mode::none, 1 };
+    if (std::strcmp(name, "fxaa") == 0)
+        return { antialiasing_mode::fxaa, 1 };
+
+    const auto samples = std::atoi(name);
+    if (samples != 2 && samples != 4 && samples != 8)
+        panic("unknown antialiasing mode %s, expected off, fxaa, 2, 4 or 8\n", name);
+    return { antialiasing_mode::msaa, samples };
+}
+
+std::string antialiasing_settings::name() const
+{
+    switch (mode) {
+    case antialiasing_mode::none:
+        return "off";
+    case antialiasing_mode::msaa:
+        return "msaa " + std::to_string(samples) + "x";
+    case antialiasing_mode::fxaa:
+        return "fxaa";
+    }
+    return {};
+}
+
+antialiasing::antialiasing(const antialiasing_settings &settings)
+    : settings_(settings)
+{
+    if (settings_.mode != antialiasing_mode::fxaa)
+        return;
+
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    fxaa_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/blur.vert");
+    fxaa_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/fxaa.frag");
+    fxaa_program_.link();
+}
+
+void antialiasing::begin(int width, int height) const
+{
+    if (settings_.mode == antialiasing_mode::none)
+        return;
+
+    const auto samples = settings_.mode == antialiasing_mode::msaa ? settings_.samples : 1;
+    target_ = &render_targets().acquire({ width, height, GL_RGBA8, samples, GL_DEPTH24_STENCIL8 });
+    destination_ = framebuffer::screen();
+    framebuffer::set_screen(target_);
+    framebuffer::unbind();
+}
+
+void antialiasing::end() const
+{
+    if (!target_)
+        return;
+
+    framebuffer::set_screen(destination_);
+
+    const auto width = target_->width();
+    const auto height = target_->height();
+
+    if (settings_.mode == antialiasing_mode::msaa) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target_->handle());
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination_ ? destination_->handle() : 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        framebuffer::unbind();
+    } else {
+        framebuffer::unbind();
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        quad_.bind();
+        fxaa_program_.bind();
+        fxaa_program_.set_uniform("image", 0);
+        target_->bind_texture();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    render_targets().release(*target_);
+    target_ = nullptr;
+}
+
+} // namespace gl
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "shader_program.h"
+#include "geometry.h"
+
+#include <string>
+
+namespace gl {
+
+class framebuffer;
+
+enum class antialiasing_mode
+{
+    none,
+    msaa, // multisampled scene target, resolved with glBlitFramebuffer
+    fxaa, // single sample scene target, filtered by a post pass
+};
+
+struct antialiasing_settings
+{
+    antialiasing_mode mode = antialiasing_mode::msaa;
+    int samples = 4; // msaa only
+
+    // "off", "fxaa" or a sample count
+    static antialiasing_settings parse(const char *name);
+    std::string name() const;
+};
+
+// Renders the frame into an offscreen target from render_targets() instead of a
+// multisampled default framebuffer. Between begin() and end() the target stands in for
+// the screen, framebuffer::unbind() included; end() resolves it into whatever was the
+// screen before (the default framebuffer, or dynamic_resolution's target) of the same
+// size.
+class antialiasing : private noncopyable
+{
+public:
+    explicit antialiasing(const antialiasing_settings &settings);
+
+    const antialiasing_settings &settings() const { return settings_; }
+
+    void begin(int width, int height) const;
+    void end() const;
+
+private:
+    antialiasing_settings settings_;
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    geometry quad_;
+    shader_program fxaa_program_;
+    mutable const framebuffer *target_ = nullptr;
+    mutable const framebuffer *destination_ = nullptr;
+};
+
+} // namespace gl
@@ -0,0 +1,328 @@
+#include "blur_effect.h"
+
+#include "panic.h"
+#include "gaussian_kernel.h"
+#include "render_target_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace gl {
+
+namespace {
+
+constexpr auto ComputeGroupSize = 128;
+constexpr auto MaxGlowLevels = 6;
+
+// GLSL float list, always with a decimal point
+std::string float_list(const std::vector<float> &values)
+{
+    std::string list;
+    for (auto value : values) {
+        char literal[32];
+        std::snprintf(literal, sizeof(literal), "%.8e", value);
+        if (!list.empty())
+            list += ", ";
+        list += literal;
+    }
+    return list;
+}
+
+const char *image_format(GLenum internal_format)
+{
+    switch (internal_format) {
+    case GL_RGBA8:
+        return "rgba8";
+    case GL_RGBA16F:
+        return "rgba16f";
+    case GL_RGBA32F:
+        return "rgba32f";
+    case GL_R11F_G11F_B10F:
+        return "r11f_g11f_b10f";
+    case GL_RGB10_A2:
+        return "rgb10_a2";
+    default:
+        panic("unsupported compute blur format 0x%x\n", internal_format);
+        return nullptr;
+    }
+}
+
+} // namespace
+
+blur_effect::blur_effect(int framebuffer_width, int framebuffer_height, GLenum internal_format, int levels,
+                         blur_backend backend)
+    : framebuffer_width_(framebuffer_width)
+    , framebuffer_height_(framebuffer_height)
+    , internal_format_(internal_format)
+    , backend_(backend)
+{
+    // Scenes are rendered into this one, so it keeps a depth buffer. The scratch
+    // framebuffer is only borrowed while blurring and has none.
+    framebuffer_.reset(new framebuffer(framebuffer_width, framebuffer_height, internal_format, levels));
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    if (backend_ == blur_backend::compute) {
+        compute_program_.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/blur.comp",
+                                    { "BLUR_GROUP_SIZE " + std::to_string(ComputeGroupSize),
+                                      "MAX_BLUR_RADIUS " + std::to_string(MaxKernelRadius),
+                                      std::string("BLUR_IMAGE_FORMAT ") + image_format(internal_format) });
+        compute_program_.link();
+        compute_image_location_ = compute_program_.uniform_location("image");
+        compute_radius_location_ = compute_program_.uniform_location("radius");
+        compute_weights_location_ = compute_program_.uniform_location("weights");
+        compute_horizontal_location_ = compute_program_.uniform_location("horizontal");
+
+        composite_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/blur.vert");
+        composite_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/blit.frag");
+        composite_program_.link();
+    }
+
+    glow_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/blur.vert");
+    glow_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/dual_filter.frag");
+    glow_program_.link();
+}
+
+int blur_effect::pass_count(float sigma)
+{
+    // variances add up, so n passes of sigma / sqrt(n) are a blur of sigma
+    const auto ratio = 3.0f * sigma / MaxKernelRadius;
+    return std::max(static_cast<int>(std::ceil(ratio * ratio)), 1);
+}
+
+void blur_effect::bind() const
+{
+    bind_target(*framebuffer_);
+}
+
+void blur_effect::render(int width, int height, int passes) const
+{
+    render_gaussian(width, height, PassSigma * std::sqrt(static_cast<float>(passes)));
+}
+
+void blur_effect::render_gaussian(int width, int height, float sigma) const
+{
+    const auto passes = pass_count(sigma);
+    const auto pass_sigma = sigma / std::sqrt(static_cast<float>(passes));
+
+    if (backend_ == blur_backend::compute) {
+        dispatch_blur(gaussian_weights(pass_sigma, MaxKernelRadius), passes);
+
+        framebuffer::unbind();
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        quad_.bind();
+        composite_program_.bind();
+        composite_program_.set_uniform("image", 0);
+        framebuffer_->bind_texture();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        glDisable(GL_BLEND);
+        return;
+    }
+
+    const auto &program = begin(pass_sigma);
+    const auto &scratch = render_targets().acquire({ framebuffer_width_, framebuffer_height_, internal_format_ });
+
+    for (int i = 0; i < passes; ++i) {
+        // framebuffer -> scratch
+
+        bind_target(scratch);
+        draw_pass(program, *framebuffer_, false);
+
+        // scratch -> framebuffer or screen
+
+        if (i < passes - 1) {
+            bind_target(*framebuffer_);
+        } else {
+            // last pass, render to screen
+            framebuffer::unbind();
+            glViewport(0, 0, width, height);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+
+        draw_pass(program, scratch, true);
+    }
+
+    glDisable(GL_BLEND);
+    render_targets().release(scratch);
+}
+
+void blur_effect::render_glow(int width, int height, float radius) const
+{
+    // every level doubles the reach, the tap spread covers what's between the levels
+    const auto depth = std::max(std::floor(std::log2(std::max(radius, 1.0f))), 1.0f);
+    auto levels = std::min(static_cast<int>(depth), MaxGlowLevels);
+    while (levels > 1 && std::min(framebuffer_width_, framebuffer_height_) >> levels < 1)
+        --levels;
+    const auto spread = std::clamp(radius / std::exp2(static_cast<float>(levels)), 0.5f, 2.0f);
+
+    std::vector<const framebuffer *> pyramid;
+    for (int level = 1; level <= levels; ++level) {
+        pyramid.push_back(&render_targets().acquire(
+                { std::max(framebuffer_width_ >> level, 1), std::max(framebuffer_height_ >> level, 1), internal_format_ }));
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    quad_.bind();
+    glow_program_.bind();
+    glow_program_.set_uniform("image", 0);
+
+    const auto *source = framebuffer_.get();
+    for (auto *target : pyramid) {
+        bind_target(*target);
+        draw_glow_pass(*source, true, 1.0f);
+        source = target;
+    }
+
+    for (int i = levels - 2; i >= 0; --i) {
+        bind_target(*pyramid[i]);
+        draw_glow_pass(*source, false, spread);
+        source = pyramid[i];
+    }
+
+    // the last upsample goes straight to the screen
+    framebuffer::unbind();
+    glViewport(0, 0, width, height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    draw_glow_pass(*source, false, spread);
+    glDisable(GL_BLEND);
+
+    for (auto *target : pyramid)
+        render_targets().release(*target);
+}
+
+void blur_effect::draw_glow_pass(const framebuffer &source, bool downsample, float spread) const
+{
+    source.bind_texture();
+    glow_program_.set_uniform("downsample", downsample ? 1 : 0);
+    glow_program_.set_uniform("spread", spread);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void blur_effect::blur(int passes) const
+{
+    blur_gaussian(PassSigma * std::sqrt(static_cast<float>(passes)));
+}
+
+void blur_effect::blur_gaussian(float sigma) const
+{
+    const auto passes = pass_count(sigma);
+    const auto pass_sigma = sigma / std::sqrt(static_cast<float>(passes));
+
+    if (backend_ == blur_backend::compute) {
+        dispatch_blur(gaussian_weights(pass_sigma, MaxKernelRadius), passes);
+    } else {
+        const auto &program = begin(pass_sigma);
+        const auto &scratch = render_targets().acquire({ framebuffer_width_, framebuffer_height_, internal_format_ });
+        glDisable(GL_BLEND);
+
+        for (int i = 0; i < passes; ++i) {
+            bind_target(scratch);
+            draw_pass(program, *framebuffer_, false);
+
+            bind_target(*framebuffer_);
+            draw_pass(program, scratch, true);
+        }
+
+        framebuffer::unbind();
+        render_targets().release(scratch);
+    }
+
+    if (framebuffer_->levels() > 1)
+        framebuffer_->generate_mipmap();
+}
+
+const blur_effect::pass_program &blur_effect::begin(float sigma) const
+{
+    auto &pass = programs_[sigma];
+    if (!pass.program) {
+        // the kernel is baked into the shader, so the tap loop is unrolled with constant
+        // offsets and weights
+        std::vector<float> offsets, weights;
+        for (const auto &tap : linear_taps(gaussian_weights(sigma, MaxKernelRadius))) {
+            offsets.push_back(tap.offset);
+            weights.push_back(tap.weight);
+        }
+
+        auto *program = new shader_program;
+        pass.program.reset(program);
+        program->add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/blur.vert");
+        program->add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/blur.frag",
+                            { "BLUR_TAP_COUNT " + std::to_string(offsets.size()), "BLUR_OFFSETS " + float_list(offsets),
+                              "BLUR_WEIGHTS " + float_list(weights) });
+        program->link();
+        pass.image_location = program->uniform_location("image");
+        pass.horizontal_location = program->uniform_location("horizontal");
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    quad_.bind();
+
+    pass.program->bind();
+    pass.program->set_uniform(pass.image_location, 0);
+    return pass;
+}
+
+void blur_effect::bind_target(const framebuffer &target) const
+{
+    target.bind();
+    glViewport(0, 0, target.width(), target.height());
+}
+
+void blur_effect::draw_pass(const pass_program &program, const framebuffer &source, bool horizontal) const
+{
+    source.bind_texture();
+    program.program->set_uniform(program.horizontal_location, horizontal ? 1 : 0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void blur_effect::dispatch_blur(const std::vector<float> &weights, int passes) const
+{
+    framebuffer::unbind();
+
+    compute_program_.bind();
+    compute_program_.set_uniform(compute_image_location_, 0);
+    compute_program_.set_uniform(compute_radius_location_, static_cast<int>(weights.size()) - 1);
+    compute_program_.set_uniform(compute_weights_location_, weights);
+
+    const auto &scratch = render_targets().acquire({ framebuffer_width_, framebuffer_height_, internal_format_ });
+
+    // framebuffer -> scratch -> framebuffer
+    for (int i = 0; i < passes; ++i) {
+        dispatch_pass(*framebuffer_, scratch, true);
+        dispatch_pass(scratch, *framebuffer_, false);
+    }
+
+    render_targets().release(scratch);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, internal_format_);
+
+    // the result is sampled, mipmapped or rendered to next
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+}
+
+void blur_effect::dispatch_pass(const framebuffer &source, const framebuffer &target, bool horizontal) const
+{
+    source.bind_texture();
+    glBindImageTexture(0, target.texture_handle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, internal_format_);
+    compute_program_.set_uniform(compute_horizontal_location_, horizontal ? 1 : 0);
+
+    // a workgroup per span of a row or a column
+    const auto length = horizontal ? framebuffer_width_ : framebuffer_height_;
+    const auto lines = horizontal ? framebuffer_height_ : framebuffer_width_;
+    glDispatchCompute((length + ComputeGroupSize - 1) / ComputeGroupSize, lines, 1);
+
+    // the next pass reads what this one wrote
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+} // namespace gl
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "shader_program.h"
+#include "framebuffer.h"
+#include "geometry.h"
+
+#include <map>
+#include <memory>
+
+namespace gl {
+
+enum class blur_backend
+{
+    fragment, // full screen draws ping-ponging between the framebuffers, linearly sampled taps
+    compute,  // shared memory tiles, a texel fetch per texel
+};
+
+// Separable Gaussian blur: whatever is rendered after bind() is blurred back and forth
+// between its framebuffer and a scratch one of the same format from render_targets().
+// Kernels are generated for any sigma; wide ones are split into several narrower passes.
+// render_glow() is a cheaper wide blur through a pyramid of half resolution framebuffers,
+// also from the pool.
+class blur_effect : private noncopyable
+{
+public:
+    // GL_R11F_G11F_B10F keeps HDR range at the bandwidth of GL_RGBA8, for glows of
+    // anything brighter than 1; the compute backend supports it, GL_RGB10_A2, GL_RGBA8,
+    // GL_RGBA16F and GL_RGBA32F
+    blur_effect(int framebuffer_width, int framebuffer_height, GLenum internal_format = GL_RGBA8, int levels = 1,
+                blur_backend backend = blur_backend::compute);
+
+    int width() const { return framebuffer_width_; }
+    int height() const { return framebuffer_height_; }
+
+    // sigma of a single pass of render() and blur()
+    static constexpr auto PassSigma = 1.8f;
+    // widest pass, keeps the compute shared memory tile well under 32KB
+    static constexpr auto MaxKernelRadius = 64;
+
+    // passes a blur of this sigma is split into
+    static int pass_count(float sigma);
+
+    void bind() const;
+
+    // Blurs and adds the result to the default framebuffer.
+    void render_gaussian(int width, int height, float sigma) const;
+
+    // Same as render_gaussian() with the sigma of `passes` passes of PassSigma.
+    void render(int width, int height, int passes) const;
+
+    // Dual filter glow (Bjørge, "Bandwidth-Efficient Rendering", SIGGRAPH 2015): the
+    // image is downsampled into the pyramid and upsampled back with tent filters, then
+    // added to the default framebuffer. radius, in texels of the blur framebuffer, picks
+    // how deep the pyramid goes and how far apart the upsampling taps are, so the cost
+    // only grows with its logarithm.
+    void render_glow(int width, int height, float radius) const;
+
+    // Blurs in place, leaving the result in the texture bound by bind_texture() with its
+    // mip chain (if any) rebuilt.
+    void blur_gaussian(float sigma) const;
+    void blur(int passes) const;
+
+    void bind_texture() const { framebuffer_->bind_texture(); }
+
+private:
+    // a fragment program with its uniform locations, looked up once
+    struct pass_program
+    {
+        std::unique_ptr<shader_program> program;
+        int image_location;
+        int horizontal_location;
+    };
+
+    // the program of a pass of this sigma, bound
+    const pass_program &begin(float sigma) const;
+    void bind_target(const framebuffer &target) const;
+    void draw_pass(const pass_program &program, const framebuffer &source, bool horizontal) const;
+    // `passes` passes of the kernel, result in framebuffer_
+    void dispatch_blur(const std::vector<float> &weights, int passes) const;
+    void dispatch_pass(const framebuffer &source, const framebuffer &target, bool horizontal) const;
+    void draw_glow_pass(const framebuffer &source, bool downsample, float spread) const;
+
+    int framebuffer_width_;
+    int framebuffer_height_;
+    GLenum internal_format_;
+    blur_backend backend_;
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    geometry quad_;
+    mutable std::map<float, pass_program> programs_; // by pass sigma
+    shader_program compute_program_;
+    int compute_image_location_ = -1;
+    int compute_radius_location_ = -1;
+    int compute_weights_location_ = -1;
+    int compute_horizontal_location_ = -1;
+    shader_program composite_program_;
+    shader_program glow_program_;
+    std::unique_ptr<framebuffer> framebuffer_;
+};
+
+} // namespace gl
@@ -1,26 +1,36 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "caps.h"
+#include "buffer_storage.h"
 
 #include <GL/glew.h>
 
+#include <cassert>
+#include <cstddef>
+
 namespace gl {
 
 template <typename T>
 class buffer : private noncopyable
 {
 public:
-    buffer(GLenum target, const T *data, size_t size)
+    buffer(GLenum target, const T *data, size_t size, buffer_storage storage)
         : target_(target)
+        , size_(size)
+        , storage_(storage)
     {
-        glGenBuffers(1, &id_);
-
-        bind();
-        glBufferData(target_, size * sizeof(T), data, GL_DYNAMIC_DRAW);
+        if (caps().direct_state_access) {
+            glCreateBuffers(1, &id_);
+        } else {
+            glGenBuffers(1, &id_);
+            bind();
+        }
+        detail::init_buffer_storage(target_, id_, size * sizeof(T), data, storage_);
     }
 
-    buffer(GLenum target, size_t size)
-        : buffer(target, nullptr, size)
+    buffer(GLenum target, size_t size, buffer_storage storage)
+        : buffer(target, nullptr, size, storage)
     {
     }
 
@@ -37,6 +47,16 @@ public:
         return id_;
     }
 
+    size_t size() const
+    {
+        return size_;
+    }
+
+    buffer_storage storage() const
+    {
+        return storage_;
+    }
+
     void bind() const
     {
         glBindBuffer(target_, id_);
@@ -49,30 +69,42 @@ public:
 
     void set_sub_data(size_t offset, const T *data, size_t size) const
     {
-        bind();
-        glBufferSubData(target_, offset * sizeof(T), size * sizeof(T), data);
+        assert(storage_ == buffer_storage::stream && "only stream buffers are written from the CPU");
+
+        if (caps().direct_state_access) {
+            glNamedBufferSubData(id_, offset * sizeof(T), size * sizeof(T), data);
+        } else {
+            bind();
+            glBufferSubData(target_, offset * sizeof(T), size * sizeof(T), data);
+        }
     }
 
     void get_sub_data(size_t offset, T *data, size_t size) const
     {
-        bind();
-        glGetBufferSubData(target_, offset * sizeof(T), size * sizeof(T), data);
+        if (caps().direct_state_access) {
+            glGetNamedBufferSubData(id_, offset * sizeof(T), size * sizeof(T), data);
+        } else {
+            bind();
+            glGetBufferSubData(target_, offset * sizeof(T), size * sizeof(T), data);
+        }
     }
 
+    // write-only for stream buffers (previous contents are discarded), read-only for
+    // readback buffers
     T *map() const
     {
-        bind();
-        return static_cast<T *>(glMapBuffer(target_, GL_WRITE_ONLY));
+        return static_cast<T *>(detail::map_buffer(target_, id_, size_ * sizeof(T), storage_));
     }
 
     void unmap() const
     {
-        bind();
-        glUnmapBuffer(target_);
+        detail::unmap_buffer(target_, id_);
     }
 
 private:
     GLenum target_;
+    size_t size_;
+    buffer_storage storage_;
     GLuint id_;
 };
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "caps.h"
+
+#include <GL/glew.h>
+
+#include <cassert>
+
+namespace gl {
+
+// What a buffer is used for, which decides how its data store is allocated and how
+// the CPU may write to it (checked with asserts).
+enum class buffer_storage
+{
+    immutable, // contents given at creation, never written from the CPU afterwards
+    stream,    // rewritten every frame, with set_sub_data or by mapping it
+    readback,  // written by the GPU and read back (get_sub_data or mapping it)
+};
+
+namespace detail {
+
+// Allocates the data store of buffer `id`, which must be bound to `target` unless
+// direct state access is in use.
+inline void init_buffer_storage(GLenum target, GLuint id, GLsizeiptr size, const void *data, buffer_storage storage)
+{
+    const auto dsa = caps().direct_state_access;
+
+    switch (storage) {
+    case buffer_storage::immutable:
+        // no dynamic or map bits, so the driver can keep it in video memory
+        if (dsa)
+            glNamedBufferStorage(id, size, data, 0);
+        else
+            glBufferStorage(target, size, data, 0);
+        break;
+
+    case buffer_storage::stream:
+        // left mutable so that mapping with GL_MAP_INVALIDATE_BUFFER_BIT orphans the
+        // previous contents instead of waiting for the GPU to be done with them
+        if (dsa)
+            glNamedBufferData(id, size, data, GL_STREAM_DRAW);
+        else
+            glBufferData(target, size, data, GL_STREAM_DRAW);
+        break;
+
+    case buffer_storage::readback:
+        if (dsa)
+            glNamedBufferStorage(id, size, data, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+        else
+            glBufferStorage(target, size, data, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+        break;
+    }
+}
+
+// Maps the whole buffer: write-only and invalidated for stream buffers, read-only
+// for readback buffers.
+inline void *map_buffer(GLenum target, GLuint id, GLsizeiptr size, buffer_storage storage)
+{
+    assert(storage != buffer_storage::immutable && "immutable buffers can't be mapped");
+
+    const GLbitfield access =
+            storage == buffer_storage::stream ? GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT : GL_MAP_READ_BIT;
+
+    if (caps().direct_state_access)
+        return glMapNamedBufferRange(id, 0, size, access);
+
+    glBindBuffer(target, id);
+    return glMapBufferRange(target, 0, size, access);
+}
+
+inline void unmap_buffer(GLenum target, GLuint id)
+{
+    if (caps().direct_state_access) {
+        glUnmapNamedBuffer(id);
+    } else {
+        glBindBuffer(target, id);
+        glUnmapBuffer(target);
+    }
+}
+
+} // namespace detail
+
+} // namespace gl
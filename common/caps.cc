@@ -0,0 +1,45 @@
+#include "caps.h"
+
+#include <GL/glew.h>
+
+#include <cstring>
+
+namespace gl {
+
+namespace {
+
+context_caps current_caps;
+
+bool has_extension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const auto *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+const context_caps &caps()
+{
+    return current_caps;
+}
+
+void detect_caps()
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &current_caps.major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &current_caps.minor_version);
+
+#ifdef WITH_DSA
+    const auto version = current_caps.major_version * 10 + current_caps.minor_version;
+    current_caps.direct_state_access = version >= 45 || has_extension("GL_ARB_direct_state_access");
+#endif
+
+    current_caps.vertex_shader_layer = has_extension("GL_ARB_shader_viewport_layer_array");
+}
+
+} // namespace gl
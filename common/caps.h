@@ -0,0 +1,22 @@
+#pragma once
+
+namespace gl {
+
+// What the current context can do beyond the 4.3 core baseline the demos ask for.
+struct context_caps
+{
+    int major_version = 0;
+    int minor_version = 0;
+    // GL 4.5 (or ARB_direct_state_access): the wrappers create and edit objects by
+    // name instead of binding them first
+    bool direct_state_access = false;
+    // ARB_shader_viewport_layer_array: vertex shaders can write gl_Layer, so layered
+    // rendering doesn't need a geometry shader
+    bool vertex_shader_layer = false;
+};
+
+// Filled in by window once its context is current.
+const context_caps &caps();
+void detect_caps();
+
+} // namespace gl
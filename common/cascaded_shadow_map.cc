@@ -0,0 +1,132 @@
+#include "cascaded_shadow_map.h"
+
+#include "shader_program.h"
+#include "panic.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace gl {
+
+namespace {
+
+std::vector<float> practical_splits(float near, float far, int count, float lambda)
+{
+    std::vector<float> splits(count);
+    for (int i = 0; i < count; ++i) {
+        const auto f = static_cast<float>(i + 1) / count;
+        const auto log_split = near * std::pow(far / near, f);
+        const auto uniform_split = near + (far - near) * f;
+        splits[i] = lambda * log_split + (1.0f - lambda) * uniform_split;
+    }
+    return splits;
+}
+
+// world space corners of the camera frustum between view depths near and far
+std::array<glm::vec3, 8> slice_corners(const camera_frustum &camera, float near, float far)
+{
+    const auto inverse_view = glm::inverse(camera.view);
+    const auto tan_y = std::tan(0.5f * camera.fov_y);
+    const auto tan_x = tan_y * camera.aspect;
+
+    std::array<glm::vec3, 8> corners;
+    int index = 0;
+    for (auto z : { near, far }) {
+        for (auto sy : { -1.0f, 1.0f }) {
+            for (auto sx : { -1.0f, 1.0f }) {
+                const auto p = glm::vec4(sx * tan_x * z, sy * tan_y * z, -z, 1.0f);
+                corners[index++] = glm::vec3(inverse_view * p);
+            }
+        }
+    }
+    return corners;
+}
+
+} // namespace
+
+cascaded_shadow_map::cascaded_shadow_map(int size, int cascade_count)
+    : cascaded_shadow_map(shadow_buffer_desc::square(size, cascade_count))
+{
+}
+
+cascaded_shadow_map::cascaded_shadow_map(const shadow_buffer_desc &desc)
+    : size_(desc.width)
+    , buffer_(desc)
+    , cascades_(desc.layers)
+{
+    if (desc.layers < 1 || desc.layers > MaxCascades)
+        panic("unsupported cascade count %d\n", desc.layers);
+    if (desc.width != desc.height)
+        panic("cascades must be square\n");
+}
+
+bool cascaded_shadow_map::update(const camera_frustum &camera, float shadow_distance,
+                                 const glm::vec3 &light_direction, float lambda, float caster_margin)
+{
+    const auto direction = glm::normalize(light_direction);
+    const auto up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+
+    const auto splits = practical_splits(camera.near, shadow_distance, cascades_.size(), lambda);
+
+    bool changed = false;
+
+    auto near = camera.near;
+    for (std::size_t i = 0; i < cascades_.size(); ++i) {
+        const auto far = splits[i];
+        const auto corners = slice_corners(camera, near, far);
+
+        // Bound the slice with a sphere rather than a box: its size doesn't change as
+        // the camera rotates, so neither does the texel size. Rounding the radius keeps
+        // float noise from changing it between frames.
+        glm::vec3 center(0);
+        for (const auto &c : corners)
+            center += c;
+        center /= static_cast<float>(corners.size());
+
+        float radius = 0;
+        for (const auto &c : corners)
+            radius = std::max(radius, glm::length(c - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        const auto eye = center - direction * (radius + caster_margin);
+        const auto view = glm::lookAt(eye, center, up);
+        auto projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + caster_margin);
+
+        // Snap the projection to whole texels so that the map doesn't shimmer when the
+        // camera moves.
+        const auto half_size = 0.5f * size_;
+        const auto origin = projection * view * glm::vec4(0, 0, 0, 1);
+        const auto texel_x = origin.x * half_size;
+        const auto texel_y = origin.y * half_size;
+        projection[3][0] += (std::round(texel_x) - texel_x) / half_size;
+        projection[3][1] += (std::round(texel_y) - texel_y) / half_size;
+
+        const auto view_projection = projection * view;
+        if (view_projection != cascades_[i].view_projection || far != cascades_[i].split_depth)
+            changed = true;
+
+        cascades_[i] = { view_projection, far };
+        near = far;
+    }
+
+    return changed;
+}
+
+void cascaded_shadow_map::set_uniforms(const shader_program &program) const
+{
+    std::vector<glm::mat4> view_projections;
+    std::vector<float> splits;
+    for (const auto &cascade : cascades_) {
+        view_projections.push_back(cascade.view_projection);
+        splits.push_back(cascade.split_depth);
+    }
+
+    program.set_uniform("cascadeCount", static_cast<int>(cascades_.size()));
+    program.set_uniform("cascadeViewProjection", view_projections);
+    program.set_uniform("cascadeSplits", splits);
+}
+
+} // namespace gl
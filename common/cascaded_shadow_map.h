@@ -0,0 +1,70 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "multi_shadow_buffer.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gl {
+
+class shader_program;
+
+// Perspective camera the cascades are fitted to.
+struct camera_frustum
+{
+    glm::mat4 view;
+    float fov_y; // radians
+    float aspect;
+    float near;
+    float far;
+};
+
+struct shadow_cascade
+{
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    float split_depth = 0.0f; // view space distance where the next cascade takes over
+};
+
+// Cascaded shadow map for a directional light, one multi_shadow_buffer layer per
+// cascade. Shaders sample it through common/shaders/cascaded_shadows.glsl.
+class cascaded_shadow_map : private noncopyable
+{
+public:
+    static constexpr auto MaxCascades = 4; // keep in sync with cascaded_shadows.glsl
+
+    cascaded_shadow_map(int size, int cascade_count);
+    // square desc, one layer per cascade
+    explicit cascaded_shadow_map(const shadow_buffer_desc &desc);
+
+    // Splits [camera.near, shadow_distance] with the practical split scheme (lambda 0
+    // is uniform, 1 logarithmic) and fits a texel-snapped orthographic projection
+    // around each slice. caster_margin extends every cascade towards the light so
+    // that casters outside the slice still land in the map. Returns whether any cascade
+    // changed since the previous call.
+    bool update(const camera_frustum &camera, float shadow_distance, const glm::vec3 &light_direction,
+                float lambda = 0.5f, float caster_margin = 10.0f);
+
+    int size() const { return size_; }
+    int cascade_count() const { return cascades_.size(); }
+    const shadow_cascade &cascade(int index) const { return cascades_[index]; }
+
+    void bind(int cascade) const { buffer_.bind(cascade); }
+    static void unbind() { multi_shadow_buffer::unbind(); }
+
+    void bind_texture() const { buffer_.bind_texture(); }
+
+    const multi_shadow_buffer &buffer() const { return buffer_; }
+
+    // cascade matrices and splits for cascaded_shadows.glsl; the texture unit is set
+    // by the caller like for any other sampler
+    void set_uniforms(const shader_program &program) const;
+
+private:
+    int size_;
+    multi_shadow_buffer buffer_;
+    std::vector<shadow_cascade> cascades_;
+};
+
+} // namespace gl
@@ -0,0 +1,136 @@
+#include "cube_shadow_buffer.h"
+
+#include "caps.h"
+#include "framebuffer.h"
+#include "panic.h"
+#include "shader_program.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <bitset>
+
+namespace gl {
+
+cube_shadow_buffer::cube_shadow_buffer(const shadow_buffer_desc &desc)
+    : size_(desc.width)
+{
+    if (desc.width != desc.height)
+        panic("cube shadow maps must be square, not %dx%d\n", desc.width, desc.height);
+
+    texture_id_ = detail::create_depth_texture(GL_TEXTURE_CUBE_MAP, desc);
+
+    // filter across face edges instead of clamping at them
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // attaching the whole cube map makes the framebuffer layered, gl_Layer is the face
+    if (caps().direct_state_access) {
+        glCreateFramebuffers(1, &fbo_id_);
+        glNamedFramebufferTexture(fbo_id_, GL_DEPTH_ATTACHMENT, texture_id_, 0);
+        glNamedFramebufferDrawBuffer(fbo_id_, GL_NONE);
+        glNamedFramebufferReadBuffer(fbo_id_, GL_NONE);
+        return;
+    }
+
+    glGenFramebuffers(1, &fbo_id_);
+
+    bind();
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    unbind();
+}
+
+cube_shadow_buffer::~cube_shadow_buffer()
+{
+    glDeleteFramebuffers(1, &fbo_id_);
+    glDeleteTextures(1, &texture_id_);
+}
+
+void cube_shadow_buffer::set_light(const glm::vec3 &position, float far, float near)
+{
+    light_position_ = position;
+    far_ = far;
+
+    // cube map face orientations, see the GL spec's table of major axis directions
+    static const std::array<std::pair<glm::vec3, glm::vec3>, FaceCount> faces = { {
+            { glm::vec3(1, 0, 0), glm::vec3(0, -1, 0) },
+            { glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0) },
+            { glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) },
+            { glm::vec3(0, -1, 0), glm::vec3(0, 0, -1) },
+            { glm::vec3(0, 0, 1), glm::vec3(0, -1, 0) },
+            { glm::vec3(0, 0, -1), glm::vec3(0, -1, 0) },
+    } };
+
+    const auto projection = glm::perspective(glm::radians(90.0f), 1.0f, near, far);
+    for (int i = 0; i < FaceCount; ++i) {
+        const auto &[direction, up] = faces[i];
+        face_view_projections_[i] = projection * glm::lookAt(position, position + direction, up);
+    }
+}
+
+unsigned cube_shadow_buffer::face_mask(const bounding_box &bounds) const
+{
+    unsigned mask = 0;
+    for (int i = 0; i < FaceCount; ++i) {
+        // culled when all corners are outside the same clip plane
+        unsigned outside = ~0u;
+        for (const auto &c : bounds.corners()) {
+            const auto p = face_view_projections_[i] * glm::vec4(c, 1.0f);
+            unsigned planes = 0;
+            planes |= p.x < -p.w ? 1 : 0;
+            planes |= p.x > p.w ? 2 : 0;
+            planes |= p.y < -p.w ? 4 : 0;
+            planes |= p.y > p.w ? 8 : 0;
+            planes |= p.z < -p.w ? 16 : 0;
+            planes |= p.z > p.w ? 32 : 0;
+            outside &= planes;
+        }
+        if (!outside)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+int cube_shadow_buffer::instance_count(unsigned face_mask)
+{
+    if (!face_mask)
+        return 0;
+    return caps().vertex_shader_layer ? std::bitset<FaceCount>(face_mask).count() : 1;
+}
+
+std::vector<std::string> cube_shadow_buffer::caster_defines()
+{
+    if (caps().vertex_shader_layer)
+        return {};
+    return { "CUBE_SHADOW_GEOMETRY_SHADER" };
+}
+
+void cube_shadow_buffer::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_);
+}
+
+void cube_shadow_buffer::unbind()
+{
+    framebuffer::unbind();
+}
+
+void cube_shadow_buffer::bind_texture() const
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id_);
+}
+
+void cube_shadow_buffer::unbind_texture() const
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+void cube_shadow_buffer::set_uniforms(const shader_program &program) const
+{
+    program.set_uniform("cubeShadowLightPosition", light_position_);
+    program.set_uniform("cubeShadowFar", far_);
+    program.set_uniform("cubeShadowFaceMatrices",
+                        std::vector<glm::mat4>(face_view_projections_.begin(), face_view_projections_.end()));
+}
+
+} // namespace gl
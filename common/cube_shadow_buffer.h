@@ -0,0 +1,70 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "shadow_buffer_desc.h"
+#include "light_frustum.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace gl {
+
+class shader_program;
+
+// Depth cube map for an omnidirectional point light, all six faces rendered in a
+// single layered pass. The depth is the linear distance to the light over far,
+// written by the casters' fragment shader, so that receivers can compare distances
+// along any direction. Shaders use common/shaders/cube_shadow.glsl.
+class cube_shadow_buffer : private noncopyable
+{
+public:
+    static constexpr auto FaceCount = 6;
+
+    // desc must be square; layers and filter don't apply
+    explicit cube_shadow_buffer(const shadow_buffer_desc &desc);
+    ~cube_shadow_buffer();
+
+    void set_light(const glm::vec3 &position, float far, float near = 0.05f);
+
+    const glm::vec3 &light_position() const { return light_position_; }
+    float far() const { return far_; }
+    const glm::mat4 &face_view_projection(int face) const { return face_view_projections_[face]; }
+
+    // Faces whose frustum the world space box reaches, one bit per face in cube map
+    // order (+x, -x, +y, -y, +z, -z). Casters only need to be drawn into those.
+    unsigned face_mask(const bounding_box &bounds) const;
+
+    // Instances to draw a caster with: one per face in the mask when the vertex shader
+    // can write gl_Layer, or one for the geometry shader to replicate; 0 when culled.
+    static int instance_count(unsigned face_mask);
+
+    // CUBE_SHADOW_GEOMETRY_SHADER when the context can't write gl_Layer from the vertex
+    // shader, for caster programs that support both paths
+    static std::vector<std::string> caster_defines();
+
+    // the layered framebuffer, all faces at once
+    void bind() const;
+    static void unbind();
+
+    int size() const { return size_; }
+
+    void bind_texture() const;
+    void unbind_texture() const;
+
+    // light position, far and face matrices, for casters and receivers alike
+    void set_uniforms(const shader_program &program) const;
+
+private:
+    int size_;
+    GLuint texture_id_;
+    GLuint fbo_id_;
+    glm::vec3 light_position_ = glm::vec3(0);
+    float far_ = 1.0f;
+    std::array<glm::mat4, FaceCount> face_view_projections_;
+};
+
+} // namespace gl
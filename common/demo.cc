@@ -1,10 +1,15 @@
 #include "demo.h"
 
+#include "render_target_pool.h"
+#include "gpu_timer.h"
+#include "stats.h"
 #include "util.h"
 #include "window.h"
 
 #include <unistd.h>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <GLFW/glfw3.h>
 
 namespace gl {
@@ -12,7 +17,14 @@ namespace gl {
 demo::demo(int argc, char *argv[])
 {
     parse_arguments(argc, argv);
-    window_.reset(new window(width_, height_, "demo"));
+    window_.reset(new window(width_, height_, "demo", 0));
+    antialiasing_.reset(new antialiasing(antialiasing_settings_));
+    if (dynamic_resolution_settings_.enabled())
+        dynamic_resolution_.reset(new dynamic_resolution(width_, height_, dynamic_resolution_settings_));
+    if (benchmark_)
+        glfwSwapInterval(0);
+    if (benchmark_ || dynamic_resolution_)
+        frame_timer_.reset(new gpu_timer("frame us, antialiasing " + antialiasing_settings_.name()));
     glfwSetKeyCallback(*window_, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
             glfwSetWindowShouldClose(window, GL_TRUE);
@@ -36,8 +48,26 @@ void demo::run()
             elapsed = 1.0f / frames_per_second_;
         }
 
+        if (frame_timer_)
+            frame_timer_->begin();
+        if (dynamic_resolution_)
+            dynamic_resolution_->begin();
+        antialiasing_->begin(render_width(), render_height());
         render();
+        antialiasing_->end();
+        if (dynamic_resolution_)
+            dynamic_resolution_->end();
+        if (frame_timer_)
+            frame_timer_->end();
+
+        if (dynamic_resolution_) {
+            dynamic_resolution_->update(frame_timer_->last_milliseconds());
+            stats::add("resolution scale (%)", std::lround(100.0f * dynamic_resolution_->scale()));
+        }
+
         update(elapsed);
+        render_targets().end_frame();
+        stats::end_frame();
 
         if (dump_frames_) {
             char path[80];
@@ -55,7 +85,7 @@ void demo::run()
 void demo::parse_arguments(int argc, char *argv[])
 {
     int opt;
-    while ((opt = getopt(argc, argv, "w:h:c:f:d")) != -1) {
+    while ((opt = getopt(argc, argv, "w:h:c:f:ds:z:a:br:u:")) != -1) {
         switch (opt)
         {
         case 'w':
@@ -73,8 +103,47 @@ void demo::parse_arguments(int argc, char *argv[])
         case 'd':
             dump_frames_ = true;
             break;
+        case 's':
+            shadow_size_ = std::atoi(optarg);
+            break;
+        case 'z':
+            shadow_depth_format_ = shadow_depth_format(std::atoi(optarg));
+            break;
+        case 'a':
+            antialiasing_settings_ = antialiasing_settings::parse(optarg);
+            break;
+        case 'b':
+            benchmark_ = true;
+            break;
+        case 'r': {
+            const auto filter = dynamic_resolution_settings_.filter;
+            dynamic_resolution_settings_ = dynamic_resolution_settings::parse(optarg);
+            dynamic_resolution_settings_.filter = filter;
+            break;
+        }
+        case 'u':
+            dynamic_resolution_settings_.filter =
+                    std::strcmp(optarg, "edge") == 0 ? upscale_filter::edge : upscale_filter::bilinear;
+            break;
         }
     }
 }
 
+int demo::render_width() const
+{
+    return dynamic_resolution_ ? dynamic_resolution_->width() : width_;
+}
+
+int demo::render_height() const
+{
+    return dynamic_resolution_ ? dynamic_resolution_->height() : height_;
+}
+
+shadow_buffer_desc demo::shadow_desc(int default_size, int layers) const
+{
+    auto desc = shadow_buffer_desc::square(shadow_size_ ? shadow_size_ : default_size, layers);
+    desc.depth_format = shadow_depth_format_;
+    return desc;
+}
+
 }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include "shadow_buffer_desc.h"
+#include "antialiasing.h"
+#include "dynamic_resolution.h"
+
 #include <memory>
 
 namespace gl
 {
 class window;
+class gpu_timer;
 
 class demo
 {
@@ -19,12 +24,30 @@ public:
 protected:
     void parse_arguments(int argc, char *argv[]);
 
+    // square shadow map of the -s size, or default_size when it wasn't given
+    shadow_buffer_desc shadow_desc(int default_size, int layers = 1) const;
+
+    // Size the scene renders at this frame, for viewports: the window's, or less with
+    // dynamic resolution. Aspect ratios still come from width_ and height_.
+    int render_width() const;
+    int render_height() const;
+
     std::unique_ptr<gl::window> window_;
+    std::unique_ptr<gl::antialiasing> antialiasing_;
+    std::unique_ptr<gl::dynamic_resolution> dynamic_resolution_;
+    std::unique_ptr<gl::gpu_timer> frame_timer_; // benchmark mode or dynamic resolution only
     int width_ = 800;
     int height_ = 800;
     bool dump_frames_ = false;
     int cycle_duration_ = 3; // seconds
     int frames_per_second_ = 40;
+    int shadow_size_ = 0; // 0 keeps the demo's default
+    GLenum shadow_depth_format_ = GL_DEPTH_COMPONENT24;
+    antialiasing_settings antialiasing_settings_; // -a off|fxaa|2|4|8
+    // -r <budget ms>[,<min scale>[,<max scale>[,<hysteresis>]]], -u bilinear|edge
+    dynamic_resolution_settings dynamic_resolution_settings_;
+    // -b: no vsync, GPU frame times reported through gl::stats
+    bool benchmark_ = false;
 };
 
 }
@@ -0,0 +1,76 @@
+#include "depth_prepass.h"
+
+#include "shader_program.h"
+#include "stats.h"
+
+#include <algorithm>
+
+namespace gl {
+
+depth_prepass::depth_prepass(bool enabled)
+    : enabled_(enabled)
+{
+    glGenQueries(QueryCount, queries_);
+}
+
+depth_prepass::~depth_prepass()
+{
+    glDeleteQueries(QueryCount, queries_);
+}
+
+void depth_prepass::build_program(shader_program &program, const char *vertex_shader, const char *fragment_shader,
+                                  std::vector<std::string> defines)
+{
+    program.add_shader(GL_VERTEX_SHADER, vertex_shader);
+    if (fragment_shader) {
+        defines.push_back("DEPTH_PREPASS");
+        program.add_shader(GL_FRAGMENT_SHADER, fragment_shader, defines);
+    } else {
+        program.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/depth_only.frag");
+    }
+    program.link();
+}
+
+void depth_prepass::begin_depth_pass() const
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+void depth_prepass::begin_shading_pass() const
+{
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    if (enabled_) {
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_EQUAL);
+    }
+
+    // the query about to be reused is the oldest one, long finished by now
+    if (pending_ == QueryCount) {
+        GLuint64 samples;
+        glGetQueryObjectui64v(queries_[current_], GL_QUERY_RESULT, &samples);
+        stats::add("shaded samples per pixel (%)", 100 * samples / query_pixels_[current_]);
+        --pending_;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint samples;
+    glGetIntegerv(GL_SAMPLES, &samples);
+    query_pixels_[current_] = static_cast<long>(viewport[2]) * viewport[3] * std::max(samples, 1);
+
+    glBeginQuery(GL_SAMPLES_PASSED, queries_[current_]);
+}
+
+void depth_prepass::end() const
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+    current_ = (current_ + 1) % QueryCount;
+    ++pending_;
+
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+} // namespace gl
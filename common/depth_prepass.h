@@ -0,0 +1,51 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+namespace gl {
+
+class shader_program;
+
+// Opaque geometry drawn twice: depth only first, then shaded with GL_EQUAL and depth
+// writes off, so expensive fragment shaders run once per pixel however the draws are
+// ordered. Disabled, the shading pass is an ordinary GL_LESS pass. Either way the
+// samples that reach the shading pass are counted with an occlusion query and reported
+// to gl::stats per pixel of the viewport, to see how much overdraw there is to save.
+class depth_prepass : private noncopyable
+{
+public:
+    explicit depth_prepass(bool enabled);
+    ~depth_prepass();
+
+    bool enabled() const { return enabled_; }
+
+    // The depth pass twin of a shading program. It has the same vertex shader, which
+    // must declare `invariant gl_Position` so both passes rasterize the same depths.
+    // Materials that discard pass their own fragment shader, built with DEPTH_PREPASS
+    // defined so it can skip the shading; the others get an empty one.
+    static void build_program(shader_program &program, const char *vertex_shader,
+                              const char *fragment_shader = nullptr, std::vector<std::string> defines = {});
+
+    // color writes off, GL_LESS with depth writes
+    void begin_depth_pass() const;
+    // color writes back on; GL_EQUAL without depth writes when enabled
+    void begin_shading_pass() const;
+    // back to GL_LESS with depth writes
+    void end() const;
+
+private:
+    static constexpr auto QueryCount = 4;
+
+    bool enabled_;
+    GLuint queries_[QueryCount];
+    mutable long query_pixels_[QueryCount] = {}; // viewport samples each query covered
+    mutable int current_ = 0;
+    mutable int pending_ = 0;
+};
+
+} // namespace gl
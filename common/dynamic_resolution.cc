@@ -0,0 +1,110 @@
+#include "dynamic_resolution.h"
+
+#include "framebuffer.h"
+#include "render_target_pool.h"
+#include "panic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace gl {
+
+namespace {
+
+// Scales are rounded to steps, so the pool only ever sees a handful of target sizes.
+constexpr auto ScaleStep = 1.0f / 20.0f;
+// gpu_timer results are a few frames late
+constexpr auto SettleFrames = 6;
+
+} // namespace
+
+dynamic_resolution_settings dynamic_resolution_settings::parse(const char *arguments)
+{
+    dynamic_resolution_settings settings;
+    if (std::sscanf(arguments, "%f,%f,%f,%f", &settings.budget_ms, &settings.min_scale, &settings.max_scale,
+                    &settings.hysteresis) < 1 ||
+        settings.min_scale <= 0.0f || settings.min_scale > settings.max_scale)
+        panic("invalid dynamic resolution settings %s\n", arguments);
+    return settings;
+}
+
+dynamic_resolution::dynamic_resolution(int width, int height, const dynamic_resolution_settings &settings)
+    : window_width_(width)
+    , window_height_(height)
+    , settings_(settings)
+    , scale_(settings.max_scale)
+{
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    upscale_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/blur.vert");
+    if (settings_.filter == upscale_filter::edge)
+        upscale_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/upscale.frag");
+    else
+        upscale_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/blit.frag");
+    upscale_program_.link();
+}
+
+int dynamic_resolution::width() const
+{
+    return std::max(static_cast<int>(std::lround(window_width_ * scale_)), 1);
+}
+
+int dynamic_resolution::height() const
+{
+    return std::max(static_cast<int>(std::lround(window_height_ * scale_)), 1);
+}
+
+void dynamic_resolution::begin() const
+{
+    target_ = &render_targets().acquire({ width(), height(), GL_RGBA8, 1, GL_DEPTH24_STENCIL8 });
+    framebuffer::set_screen(target_);
+    framebuffer::unbind();
+}
+
+void dynamic_resolution::end() const
+{
+    framebuffer::set_screen(nullptr);
+    framebuffer::unbind();
+    glViewport(0, 0, window_width_, window_height_);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    quad_.bind();
+    upscale_program_.bind();
+    upscale_program_.set_uniform("image", 0);
+    target_->bind_texture();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    render_targets().release(*target_);
+    target_ = nullptr;
+}
+
+void dynamic_resolution::update(float frame_ms)
+{
+    if (settle_frames_ > 0) {
+        --settle_frames_;
+        return;
+    }
+
+    const auto budget = settings_.budget_ms;
+    if (frame_ms <= 0.0f || std::abs(frame_ms - budget) < settings_.hysteresis * budget)
+        return;
+
+    // GPU time mostly follows the pixel count, the square of the scale; only go halfway
+    // there, single frame times are noisy
+    const auto ideal = scale_ * std::sqrt(budget / frame_ms);
+    auto scale = std::round((scale_ + 0.5f * (ideal - scale_)) / ScaleStep) * ScaleStep;
+    // outside the band, so always move, even when half the way rounds back to scale_
+    if (scale == scale_)
+        scale += frame_ms > budget ? -ScaleStep : ScaleStep;
+    scale = std::clamp(scale, settings_.min_scale, settings_.max_scale);
+
+    if (scale != scale_) {
+        scale_ = scale;
+        settle_frames_ = SettleFrames;
+    }
+}
+
+} // namespace gl
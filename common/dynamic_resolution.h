@@ -0,0 +1,65 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "shader_program.h"
+#include "geometry.h"
+
+namespace gl {
+
+class framebuffer;
+
+enum class upscale_filter
+{
+    bilinear,
+    edge, // bilinear, blurred along strong edges to hide the stair steps
+};
+
+struct dynamic_resolution_settings
+{
+    float budget_ms = 0.0f; // GPU time per frame to aim for, 0 renders at native resolution
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    // the scale stays put while the frame time is within this fraction of the budget
+    float hysteresis = 0.1f;
+    upscale_filter filter = upscale_filter::bilinear;
+
+    bool enabled() const { return budget_ms > 0.0f; }
+
+    // "<budget ms>[,<min scale>[,<max scale>[,<hysteresis>]]]"
+    static dynamic_resolution_settings parse(const char *arguments);
+};
+
+// Renders the scene into an offscreen target scaled down from the window, sized from
+// recent GPU frame times against a budget, and upscales it to the default framebuffer.
+// Between begin() and end() the target stands in for the screen, like antialiasing's.
+class dynamic_resolution : private noncopyable
+{
+public:
+    dynamic_resolution(int width, int height, const dynamic_resolution_settings &settings);
+
+    float scale() const { return scale_; }
+
+    // size of the scene this frame
+    int width() const;
+    int height() const;
+
+    void begin() const;
+    void end() const;
+
+    // Feeds back the GPU time of a recent frame. The scale moves at most every few frames,
+    // so the timer results have caught up with the previous change.
+    void update(float frame_ms);
+
+private:
+    int window_width_;
+    int window_height_;
+    dynamic_resolution_settings settings_;
+    float scale_;
+    int settle_frames_ = 0;
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    geometry quad_;
+    shader_program upscale_program_;
+    mutable const framebuffer *target_ = nullptr;
+};
+
+} // namespace gl
@@ -1,59 +1,210 @@
 #include "framebuffer.h"
 
+#include "caps.h"
+#include "panic.h"
+
 namespace gl {
 
-framebuffer::framebuffer(int width, int height)
-    : width_{ width }
-    , height_{ height }
+namespace {
+
+GLenum depth_attachment_point(GLenum internal_format)
 {
-    glGenTextures(1, &texture_id_);
-    glGenFramebuffers(1, &fbo_id_);
-    glGenRenderbuffers(1, &rbo_id_);
-
-    // initialize texture
-
-    // note to self: non-power of 2 textures are allowed on es >2.0 if
-    // GL_MIN_FILTER is set to a function that doesn't require mipmaps
-    // and texture wrap is set to GL_CLAMP_TO_EDGE
-
-    bind_texture();
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    unbind_texture();
-
-    // initialize framebuffer/renderbuffer
-
-    bind();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id_, 0);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo_id_);
+    return internal_format == GL_DEPTH24_STENCIL8 || internal_format == GL_DEPTH32F_STENCIL8
+                   ? GL_DEPTH_STENCIL_ATTACHMENT
+                   : GL_DEPTH_ATTACHMENT;
+}
+
+const framebuffer *screen_target = nullptr;
+
+} // namespace
+
+framebuffer::framebuffer(int width, int height, GLenum internal_format, int levels, int samples)
+    : framebuffer(make_desc(width, height, internal_format, levels, samples))
+{
+}
+
+framebuffer::framebuffer(const framebuffer_desc &desc, const framebuffer *shared_depth)
+    : desc_{ desc }
+    , texture_target_(desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D)
+{
+    if (desc_.samples > 1)
+        desc_.levels = 1;
+
+    if (shared_depth) {
+        if (shared_depth->width() != desc_.width || shared_depth->height() != desc_.height ||
+            shared_depth->samples() != desc_.samples)
+            panic("shared depth buffer doesn't match the framebuffer\n");
+        desc_.depth = shared_depth->desc().depth;
+        depth_id_ = shared_depth->depth_id_;
+    } else if (desc_.depth.internal_format != GL_NONE) {
+        depth_id_ = create_storage(desc_.depth, true);
+        owns_depth_ = true;
+    }
+
+    for (const auto &attachment : desc_.color)
+        color_ids_.push_back(create_storage(attachment, false));
+
+    std::vector<GLenum> draw_buffers;
+    for (std::size_t i = 0; i < color_ids_.size(); ++i)
+        draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+
+    if (caps().direct_state_access) {
+        glCreateFramebuffers(1, &fbo_id_);
+    } else {
+        glGenFramebuffers(1, &fbo_id_);
+        bind();
+    }
+
+    for (std::size_t i = 0; i < color_ids_.size(); ++i)
+        attach(GL_COLOR_ATTACHMENT0 + i, desc_.color[i], color_ids_[i]);
+    if (depth_id_)
+        attach(depth_attachment_point(desc_.depth.internal_format), desc_.depth, depth_id_);
+
+    if (caps().direct_state_access) {
+        if (draw_buffers.empty()) {
+            glNamedFramebufferDrawBuffer(fbo_id_, GL_NONE);
+            glNamedFramebufferReadBuffer(fbo_id_, GL_NONE);
+        } else {
+            glNamedFramebufferDrawBuffers(fbo_id_, draw_buffers.size(), draw_buffers.data());
+        }
+        return;
+    }
+
+    if (draw_buffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    } else {
+        glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+    }
     unbind();
 }
 
 framebuffer::~framebuffer()
 {
     glDeleteFramebuffers(1, &fbo_id_);
-    glDeleteRenderbuffers(1, &rbo_id_);
+    for (std::size_t i = 0; i < color_ids_.size(); ++i) {
+        if (desc_.color[i].storage == attachment_storage::texture)
+            glDeleteTextures(1, &color_ids_[i]);
+        else
+            glDeleteRenderbuffers(1, &color_ids_[i]);
+    }
+    if (owns_depth_) {
+        if (desc_.depth.storage == attachment_storage::texture)
+            glDeleteTextures(1, &depth_id_);
+        else
+            glDeleteRenderbuffers(1, &depth_id_);
+    }
+}
+
+framebuffer_desc framebuffer::make_desc(int width, int height, GLenum internal_format, int levels, int samples)
+{
+    framebuffer_desc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.color = { { internal_format } };
+    desc.levels = levels;
+    desc.samples = samples;
+    return desc;
+}
+
+GLuint framebuffer::create_storage(const framebuffer_attachment &attachment, bool depth) const
+{
+    const auto width = desc_.width;
+    const auto height = desc_.height;
+    const auto samples = desc_.samples;
+    GLuint id;
+
+    if (attachment.storage == attachment_storage::renderbuffer) {
+        // 0 samples is a plain renderbuffer
+        if (caps().direct_state_access) {
+            glCreateRenderbuffers(1, &id);
+            glNamedRenderbufferStorageMultisample(id, samples > 1 ? samples : 0, attachment.internal_format, width,
+                                                  height);
+        } else {
+            glGenRenderbuffers(1, &id);
+            glBindRenderbuffer(GL_RENDERBUFFER, id);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples > 1 ? samples : 0, attachment.internal_format,
+                                             width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        }
+        return id;
+    }
+
+    // multisample textures aren't filtered, only fetched or resolved
+    const auto levels = depth ? 1 : desc_.levels;
+    const auto min_filter = depth ? GL_NEAREST : levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    const auto mag_filter = depth ? GL_NEAREST : GL_LINEAR;
+
+    if (caps().direct_state_access) {
+        glCreateTextures(texture_target_, 1, &id);
+        if (samples > 1) {
+            glTextureStorage2DMultisample(id, samples, attachment.internal_format, width, height, GL_TRUE);
+        } else {
+            glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, min_filter);
+            glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, mag_filter);
+            glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTextureStorage2D(id, levels, attachment.internal_format, width, height);
+        }
+        return id;
+    }
+
+    glGenTextures(1, &id);
+    glBindTexture(texture_target_, id);
+    if (samples > 1) {
+        glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, attachment.internal_format, width, height,
+                                  GL_TRUE);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexStorage2D(GL_TEXTURE_2D, levels, attachment.internal_format, width, height);
+    }
+    glBindTexture(texture_target_, 0);
+    return id;
+}
+
+// without direct state access, assumes the framebuffer is bound
+void framebuffer::attach(GLenum attachment_point, const framebuffer_attachment &attachment, GLuint id) const
+{
+    const auto renderbuffer = attachment.storage == attachment_storage::renderbuffer;
+    if (caps().direct_state_access) {
+        if (renderbuffer)
+            glNamedFramebufferRenderbuffer(fbo_id_, attachment_point, GL_RENDERBUFFER, id);
+        else
+            glNamedFramebufferTexture(fbo_id_, attachment_point, id, 0);
+    } else {
+        if (renderbuffer)
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment_point, GL_RENDERBUFFER, id);
+        else
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment_point, texture_target_, id, 0);
+    }
 }
 
 void framebuffer::bind() const
 {
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo_id_);
 }
 
 void framebuffer::unbind()
 {
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, screen_target ? screen_target->fbo_id_ : 0);
 }
 
-void framebuffer::bind_texture() const
+void framebuffer::set_screen(const framebuffer *target)
 {
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    screen_target = target;
+}
+
+const framebuffer *framebuffer::screen()
+{
+    return screen_target;
+}
+
+void framebuffer::bind_texture(int index) const
+{
+    glBindTexture(texture_target_, color_ids_[index]);
 }
 
 void framebuffer::unbind_texture()
@@ -61,4 +212,24 @@ void framebuffer::unbind_texture()
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void framebuffer::bind_depth_texture() const
+{
+    glBindTexture(texture_target_, depth_id_);
+}
+
+void framebuffer::generate_mipmap() const
+{
+    for (std::size_t i = 0; i < color_ids_.size(); ++i) {
+        if (desc_.color[i].storage != attachment_storage::texture)
+            continue;
+        if (caps().direct_state_access) {
+            glGenerateTextureMipmap(color_ids_[i]);
+        } else {
+            bind_texture(i);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            unbind_texture();
+        }
+    }
+}
+
 } // namespace gl
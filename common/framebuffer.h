@@ -4,30 +4,93 @@
 
 #include <GL/glew.h>
 
+#include <vector>
+
 namespace gl {
 
+enum class attachment_storage
+{
+    texture,      // sampled or read from afterwards
+    renderbuffer, // only rendered to, or blitted somewhere else
+};
+
+struct framebuffer_attachment
+{
+    GLenum internal_format; // sized, GL_NONE for no attachment
+    attachment_storage storage = attachment_storage::texture;
+};
+
+// What a framebuffer allocates. Textures are immutable (glTexStorage) and clamped to
+// the edge; color ones are linearly filtered, depth ones aren't.
+struct framebuffer_desc
+{
+    int width = 0;
+    int height = 0;
+    std::vector<framebuffer_attachment> color = { { GL_RGBA8 } }; // GL_COLOR_ATTACHMENT0 on
+    framebuffer_attachment depth = { GL_DEPTH24_STENCIL8, attachment_storage::renderbuffer };
+    int levels = 1;  // mip levels of the color textures, filled by generate_mipmap()
+    int samples = 1; // > 1 for multisample textures and renderbuffers, without mip chains
+
+    // a single color texture and no depth buffer, for post processing passes
+    static framebuffer_desc color_only(int width, int height, GLenum internal_format)
+    {
+        framebuffer_desc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.color = { { internal_format } };
+        desc.depth = { GL_NONE };
+        return desc;
+    }
+};
+
 class framebuffer : private noncopyable
 {
 public:
-    framebuffer(int width, int height);
+    // With shared_depth, the depth attachment of that framebuffer (same size and sample
+    // count) is attached instead of allocating one; it must outlive this one.
+    explicit framebuffer(const framebuffer_desc &desc, const framebuffer *shared_depth = nullptr);
+    // levels > 1 gives the color texture a mip chain, filled by generate_mipmap();
+    // samples > 1 makes it a multisample texture instead
+    framebuffer(int width, int height, GLenum internal_format = GL_RGBA8, int levels = 1, int samples = 1);
     ~framebuffer();
 
     void bind() const;
+    // back to the screen: the default framebuffer, or whatever set_screen() redirected it to
     static void unbind();
 
-    void bind_texture() const;
+    // Makes unbind() bind target instead of the default framebuffer (nullptr to undo),
+    // so everything drawn "to the screen" lands in an offscreen scene target.
+    static void set_screen(const framebuffer *target);
+    static const framebuffer *screen();
+
+    void bind_texture(int index = 0) const;
     static void unbind_texture();
 
-    int width() const { return width_; }
-    int height() const { return height_; }
+    // the depth texture, if the depth attachment is one
+    void bind_depth_texture() const;
+
+    void generate_mipmap() const;
+
+    const framebuffer_desc &desc() const { return desc_; }
+    int width() const { return desc_.width; }
+    int height() const { return desc_.height; }
+    int levels() const { return desc_.levels; }
+    int samples() const { return desc_.samples; }
+    GLuint handle() const { return fbo_id_; }
+    GLuint texture_handle(int index = 0) const { return color_ids_[index]; }
+    GLuint depth_handle() const { return depth_id_; }
 
 private:
-    void init_texture();
+    static framebuffer_desc make_desc(int width, int height, GLenum internal_format, int levels, int samples);
+    GLuint create_storage(const framebuffer_attachment &attachment, bool depth) const;
+    void attach(GLenum attachment_point, const framebuffer_attachment &attachment, GLuint id) const;
 
-    int width_;
-    int height_;
-    GLuint texture_id_;
-    GLuint fbo_id_, rbo_id_;
+    framebuffer_desc desc_;
+    GLenum texture_target_;
+    GLuint fbo_id_;
+    std::vector<GLuint> color_ids_; // textures or renderbuffers, by desc_.color
+    GLuint depth_id_ = 0;
+    bool owns_depth_ = false;
 };
 
 } // namespace gl
@@ -0,0 +1,64 @@
+#include "free_list.h"
+
+#include <cassert>
+#include <iterator>
+
+namespace gl {
+
+free_list::free_list(std::size_t capacity)
+    : capacity_{ capacity }
+{
+    if (capacity_ > 0)
+        free_ranges_.emplace(0, capacity_);
+}
+
+std::size_t free_list::allocate(std::size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    for (auto it = free_ranges_.begin(); it != free_ranges_.end(); ++it) {
+        const auto [offset, range_size] = *it;
+        if (range_size < size)
+            continue;
+
+        free_ranges_.erase(it);
+        if (range_size > size)
+            free_ranges_.emplace(offset + size, range_size - size);
+
+        used_ += size;
+        return offset;
+    }
+
+    return npos;
+}
+
+void free_list::free(std::size_t offset, std::size_t size)
+{
+    if (size == 0)
+        return;
+
+    assert(offset + size <= capacity_);
+    used_ -= size;
+
+    auto next = free_ranges_.lower_bound(offset);
+    assert(next == free_ranges_.end() || next->first >= offset + size);
+
+    if (next != free_ranges_.end() && next->first == offset + size) {
+        size += next->second;
+        next = free_ranges_.erase(next);
+    }
+
+    if (next != free_ranges_.begin()) {
+        auto prev = std::prev(next);
+        assert(prev->first + prev->second <= offset);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+
+    free_ranges_.emplace_hint(next, offset, size);
+}
+
+} // namespace gl
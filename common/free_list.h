@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <map>
+
+namespace gl {
+
+// First-fit allocator handing out ranges of [0, capacity). Freed ranges are merged
+// with their neighbours so the space doesn't fragment into unusable slivers.
+class free_list
+{
+public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    explicit free_list(std::size_t capacity);
+
+    // returns npos if no free range is large enough
+    std::size_t allocate(std::size_t size);
+    void free(std::size_t offset, std::size_t size);
+
+    std::size_t capacity() const { return capacity_; }
+    std::size_t used() const { return used_; }
+
+private:
+    std::size_t capacity_;
+    std::size_t used_ = 0;
+    std::map<std::size_t, std::size_t> free_ranges_; // offset -> size
+};
+
+} // namespace gl
@@ -0,0 +1,47 @@
+#include "gaussian_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gl {
+
+std::vector<float> gaussian_weights(float sigma, int max_radius)
+{
+    if (sigma <= 0.0f)
+        return { 1.0f };
+
+    const auto radius = std::min(static_cast<int>(std::ceil(3.0f * sigma)), max_radius);
+
+    std::vector<float> weights(radius + 1);
+    for (int i = 0; i <= radius; ++i)
+        weights[i] = std::exp(-0.5f * i * i / (sigma * sigma));
+
+    // the cut off tails are spread over the rest
+    float sum = weights[0];
+    for (int i = 1; i <= radius; ++i)
+        sum += 2.0f * weights[i];
+    for (auto &weight : weights)
+        weight /= sum;
+
+    return weights;
+}
+
+std::vector<linear_tap> linear_taps(const std::vector<float> &weights)
+{
+    std::vector<linear_tap> taps = { { 0.0f, weights[0] } };
+
+    const int radius = weights.size() - 1;
+    for (int i = 1; i <= radius; i += 2) {
+        if (i == radius) {
+            // odd one out
+            taps.push_back({ static_cast<float>(i), weights[i] });
+            break;
+        }
+        const auto weight = weights[i] + weights[i + 1];
+        taps.push_back({ (i * weights[i] + (i + 1) * weights[i + 1]) / weight, weight });
+    }
+
+    return taps;
+}
+
+} // namespace gl
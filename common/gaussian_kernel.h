@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+namespace gl {
+
+// One bilinear fetch, offset in texels from the center along the blur direction.
+struct linear_tap
+{
+    float offset;
+    float weight;
+};
+
+// Half of a normalized Gaussian, the center weight first, cut off at 3 sigma (and at
+// max_radius texels).
+std::vector<float> gaussian_weights(float sigma, int max_radius);
+
+// The same kernel in half the fetches (Rákos, "Efficient Gaussian blur with linear
+// sampling"): past the center, each pair of weights becomes a single tap between the two
+// texels, placed so bilinear filtering returns their weighted sum. taps[0] is the center.
+std::vector<linear_tap> linear_taps(const std::vector<float> &weights);
+
+} // namespace gl
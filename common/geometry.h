@@ -1,10 +1,13 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "caps.h"
+#include "buffer_storage.h"
 
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 
+#include <cassert>
 #include <tuple>
 #include <vector>
 #include <iostream>
@@ -94,6 +97,35 @@ void declare_vertex_attrib_pointers(std::tuple<Ts...>)
     declare_vertex_attrib_pointers_impl<vertex_type>(std::index_sequence_for<Ts...>{});
 }
 
+// Same as the above, but with the DSA vertex format API: attributes read from
+// vertex buffer binding point `binding` of `vao`, which doesn't have to be bound.
+template<typename VertexT, std::size_t Index>
+void declare_vertex_attrib_format_for(GLuint vao, GLuint binding)
+{
+    using attrib_type = typename std::tuple_element<Index, VertexT>::type;
+    using attrib_traits = vertex_component_traits<attrib_type>;
+
+    constexpr size_t offset = tuple_element_offset<Index, VertexT>::value;
+
+    glEnableVertexArrayAttrib(vao, Index);
+    glVertexArrayAttribFormat(vao, Index, attrib_traits::size, attrib_traits::type, GL_FALSE, offset);
+    glVertexArrayAttribBinding(vao, Index, binding);
+}
+
+template<typename VertexT, std::size_t... Indexes>
+void declare_vertex_attrib_formats_impl(GLuint vao, GLuint binding, std::index_sequence<Indexes...>)
+{
+    std::initializer_list<int>{ (declare_vertex_attrib_format_for<VertexT, Indexes>(vao, binding), 0)... };
+}
+
+template<typename... Ts>
+void declare_vertex_attrib_formats(GLuint vao, GLuint binding, std::tuple<Ts...>)
+{
+    using vertex_type = std::tuple<Ts...>;
+    static_assert(sizeof(vertex_type) == tuple_stride<vertex_type>::value);
+    declare_vertex_attrib_formats_impl<vertex_type>(vao, binding, std::index_sequence_for<Ts...>{});
+}
+
 } // namespace detail
 
 class geometry : private noncopyable
@@ -101,8 +133,13 @@ class geometry : private noncopyable
 public:
     geometry()
     {
-        glGenBuffers(2, vbo_);
-        glGenVertexArrays(1, &vao_);
+        if (caps().direct_state_access) {
+            glCreateBuffers(2, vbo_);
+            glCreateVertexArrays(1, &vao_);
+        } else {
+            glGenBuffers(2, vbo_);
+            glGenVertexArrays(1, &vao_);
+        }
     }
 
     ~geometry()
@@ -112,28 +149,61 @@ public:
     }
 
     template<typename VertexT, typename IndexT>
-    void set_data(const std::vector<VertexT> &verts, const std::vector<IndexT> &indices)
+    void set_data(const std::vector<VertexT> &verts, const std::vector<IndexT> &indices,
+                  buffer_storage storage = buffer_storage::immutable)
     {
-        glBindVertexArray(vao_);
-
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * verts.size(), verts.data(), GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_[1]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(IndexT) * indices.size(), indices.data(), GL_STATIC_DRAW);
+        set_vertex_data(verts, storage);
+        index_buffer_size_ = sizeof(IndexT) * indices.size();
+
+        if (caps().direct_state_access) {
+            detail::init_buffer_storage(GL_ELEMENT_ARRAY_BUFFER, vbo_[1], sizeof(IndexT) * indices.size(),
+                                        indices.data(), storage);
+            glVertexArrayElementBuffer(vao_, vbo_[1]);
+        } else {
+            glBindVertexArray(vao_);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_[1]);
+            detail::init_buffer_storage(GL_ELEMENT_ARRAY_BUFFER, vbo_[1], sizeof(IndexT) * indices.size(),
+                                        indices.data(), storage);
+        }
+    }
 
-        detail::declare_vertex_attrib_pointers(VertexT{});
+    template<typename VertexT>
+    void set_data(const std::vector<VertexT> &verts, buffer_storage storage = buffer_storage::immutable)
+    {
+        set_vertex_data(verts, storage);
     }
 
+    // Vertices of stream geometry are rewritten every frame through map_vertices();
+    // whatever was there before is discarded.
     template<typename VertexT>
-    void set_data(const std::vector<VertexT> &verts)
+    VertexT *map_vertices() const
     {
-        glBindVertexArray(vao_);
+        assert(sizeof(VertexT) * vertex_count_ == vertex_buffer_size_);
+        return static_cast<VertexT *>(detail::map_buffer(GL_ARRAY_BUFFER, vbo_[0], vertex_buffer_size_, storage_));
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * verts.size(), verts.data(), GL_STATIC_DRAW);
+    void unmap_vertices() const
+    {
+        detail::unmap_buffer(GL_ARRAY_BUFFER, vbo_[0]);
+    }
 
-        detail::declare_vertex_attrib_pointers(VertexT{});
+    // Same for the indices, to reorder the primitives of stream geometry. Without DSA
+    // the vertex array is bound, since the element buffer binding is part of it.
+    template<typename IndexT>
+    IndexT *map_indices() const
+    {
+        assert(index_buffer_size_ % sizeof(IndexT) == 0);
+        if (!caps().direct_state_access)
+            glBindVertexArray(vao_);
+        return static_cast<IndexT *>(
+                detail::map_buffer(GL_ELEMENT_ARRAY_BUFFER, vbo_[1], index_buffer_size_, storage_));
+    }
+
+    void unmap_indices() const
+    {
+        if (!caps().direct_state_access)
+            glBindVertexArray(vao_);
+        detail::unmap_buffer(GL_ELEMENT_ARRAY_BUFFER, vbo_[1]);
     }
 
     void bind() const { glBindVertexArray(vao_); }
@@ -142,8 +212,34 @@ public:
     GLuint element_array_buffer_handle() const { return vbo_[1]; }
 
 private:
+    template<typename VertexT>
+    void set_vertex_data(const std::vector<VertexT> &verts, buffer_storage storage)
+    {
+        // immutable data stores can't be reallocated
+        assert((vertex_buffer_size_ == 0 || storage_ != buffer_storage::immutable) && "immutable geometry set twice");
+
+        storage_ = storage;
+        vertex_count_ = verts.size();
+        vertex_buffer_size_ = sizeof(VertexT) * verts.size();
+
+        if (caps().direct_state_access) {
+            detail::init_buffer_storage(GL_ARRAY_BUFFER, vbo_[0], vertex_buffer_size_, verts.data(), storage);
+            glVertexArrayVertexBuffer(vao_, 0, vbo_[0], 0, sizeof(VertexT));
+            detail::declare_vertex_attrib_formats(vao_, 0, VertexT{});
+        } else {
+            glBindVertexArray(vao_);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
+            detail::init_buffer_storage(GL_ARRAY_BUFFER, vbo_[0], vertex_buffer_size_, verts.data(), storage);
+            detail::declare_vertex_attrib_pointers(VertexT{});
+        }
+    }
+
     GLuint vao_;
     GLuint vbo_[2];
+    buffer_storage storage_ = buffer_storage::immutable;
+    std::size_t vertex_count_ = 0;
+    std::size_t vertex_buffer_size_ = 0;
+    std::size_t index_buffer_size_ = 0;
 };
 
 } // namespace gl
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "geometry.h"
+#include "caps.h"
+#include "free_list.h"
+#include "panic.h"
+
+#include <GL/glew.h>
+
+#include <numeric>
+#include <vector>
+
+namespace gl {
+
+namespace detail {
+
+template<typename T>
+struct index_type_traits;
+
+template<>
+struct index_type_traits<GLuint> {
+    static constexpr GLenum type = GL_UNSIGNED_INT;
+};
+
+template<>
+struct index_type_traits<GLushort> {
+    static constexpr GLenum type = GL_UNSIGNED_SHORT;
+};
+
+} // namespace detail
+
+// A mesh living inside a geometry_arena.
+struct geometry_handle
+{
+    GLint base_vertex = 0;
+    GLuint first_index = 0;
+    GLsizei count = 0;
+    GLsizei vertex_count = 0;
+
+    // handle for `count` indices starting `first` indices into this one
+    geometry_handle sub_range(GLuint first, GLsizei count) const
+    {
+        return { base_vertex, first_index + first, count, 0 };
+    }
+};
+
+// One immutable vertex buffer and one index buffer shared by every mesh with the same
+// vertex format. Meshes are suballocated out of them, so drawing a different mesh
+// only changes the offsets passed to glDrawElementsBaseVertex, not the bound VAO.
+template<typename VertexT, typename IndexT = GLuint>
+class geometry_arena : private noncopyable
+{
+public:
+    geometry_arena(std::size_t max_vertices, std::size_t max_indices)
+        : vertices_(max_vertices)
+        , indices_(max_indices)
+    {
+        if (caps().direct_state_access) {
+            glCreateVertexArrays(1, &vao_);
+            glCreateBuffers(2, vbo_);
+
+            glNamedBufferStorage(vbo_[0], sizeof(VertexT) * max_vertices, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glNamedBufferStorage(vbo_[1], sizeof(IndexT) * max_indices, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+            glVertexArrayVertexBuffer(vao_, 0, vbo_[0], 0, sizeof(VertexT));
+            glVertexArrayElementBuffer(vao_, vbo_[1]);
+            detail::declare_vertex_attrib_formats(vao_, 0, VertexT{});
+            return;
+        }
+
+        glGenVertexArrays(1, &vao_);
+        glGenBuffers(2, vbo_);
+
+        glBindVertexArray(vao_);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_[0]);
+        glBufferStorage(GL_ARRAY_BUFFER, sizeof(VertexT) * max_vertices, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_[1]);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, sizeof(IndexT) * max_indices, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        detail::declare_vertex_attrib_pointers(VertexT{});
+
+        glBindVertexArray(0);
+    }
+
+    ~geometry_arena()
+    {
+        glDeleteBuffers(2, vbo_);
+        glDeleteVertexArrays(1, &vao_);
+    }
+
+    geometry_handle allocate(const std::vector<VertexT> &verts, const std::vector<IndexT> &indices)
+    {
+        const auto base_vertex = vertices_.allocate(verts.size());
+        const auto first_index = indices_.allocate(indices.size());
+        if (base_vertex == free_list::npos || first_index == free_list::npos)
+            panic("geometry arena exhausted (%zu vertices, %zu indices requested)\n", verts.size(), indices.size());
+
+        if (caps().direct_state_access) {
+            glNamedBufferSubData(vbo_[0], sizeof(VertexT) * base_vertex, sizeof(VertexT) * verts.size(), verts.data());
+            glNamedBufferSubData(vbo_[1], sizeof(IndexT) * first_index, sizeof(IndexT) * indices.size(), indices.data());
+        } else {
+            // upload through the copy target so the element array binding of whatever
+            // VAO happens to be bound isn't disturbed
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_[0]);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(VertexT) * base_vertex, sizeof(VertexT) * verts.size(), verts.data());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_[1]);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(IndexT) * first_index, sizeof(IndexT) * indices.size(), indices.data());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        return { static_cast<GLint>(base_vertex), static_cast<GLuint>(first_index),
+                 static_cast<GLsizei>(indices.size()), static_cast<GLsizei>(verts.size()) };
+    }
+
+    // non-indexed geometry gets a trivial index list
+    geometry_handle allocate(const std::vector<VertexT> &verts)
+    {
+        std::vector<IndexT> indices(verts.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        return allocate(verts, indices);
+    }
+
+    void free(const geometry_handle &handle)
+    {
+        vertices_.free(handle.base_vertex, handle.vertex_count);
+        indices_.free(handle.first_index, handle.count);
+    }
+
+    void bind() const { glBindVertexArray(vao_); }
+
+    GLuint vertex_array_handle() const { return vao_; }
+    static constexpr GLenum index_type() { return detail::index_type_traits<IndexT>::type; }
+
+    // assumes the arena is bound
+    void draw(GLenum mode, const geometry_handle &handle) const
+    {
+        glDrawElementsBaseVertex(mode, handle.count, detail::index_type_traits<IndexT>::type,
+                                 reinterpret_cast<const GLvoid *>(sizeof(IndexT) * handle.first_index),
+                                 handle.base_vertex);
+    }
+
+    void draw(GLenum mode, const geometry_handle &handle, GLsizei instance_count) const
+    {
+        glDrawElementsInstancedBaseVertex(mode, handle.count, detail::index_type_traits<IndexT>::type,
+                                          reinterpret_cast<const GLvoid *>(sizeof(IndexT) * handle.first_index),
+                                          instance_count, handle.base_vertex);
+    }
+
+    GLuint array_buffer_handle() const { return vbo_[0]; }
+    GLuint element_array_buffer_handle() const { return vbo_[1]; }
+
+private:
+    GLuint vao_;
+    GLuint vbo_[2];
+    free_list vertices_;
+    free_list indices_;
+};
+
+} // namespace gl
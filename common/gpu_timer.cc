@@ -0,0 +1,39 @@
+#include "gpu_timer.h"
+
+#include "stats.h"
+
+namespace gl {
+
+gpu_timer::gpu_timer(std::string name)
+    : name_(std::move(name))
+{
+    glGenQueries(QueryCount, queries_);
+}
+
+gpu_timer::~gpu_timer()
+{
+    glDeleteQueries(QueryCount, queries_);
+}
+
+void gpu_timer::begin()
+{
+    // the query about to be reused is the oldest one, long finished by now
+    if (pending_ == QueryCount) {
+        GLuint64 elapsed;
+        glGetQueryObjectui64v(queries_[current_], GL_QUERY_RESULT, &elapsed);
+        stats::add(name_, elapsed / 1000);
+        last_milliseconds_ = elapsed / 1e6f;
+        --pending_;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, queries_[current_]);
+}
+
+void gpu_timer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    current_ = (current_ + 1) % QueryCount;
+    ++pending_;
+}
+
+} // namespace gl
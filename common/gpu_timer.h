@@ -0,0 +1,36 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <GL/glew.h>
+
+#include <string>
+
+namespace gl {
+
+// GPU time spent between begin() and end(), added to the stats counter `name` in
+// microseconds. Queries are recycled a few frames later, so reading them back doesn't
+// stall the pipeline; the first frames aren't reported.
+class gpu_timer : private noncopyable
+{
+public:
+    explicit gpu_timer(std::string name);
+    ~gpu_timer();
+
+    void begin();
+    void end();
+
+    // the most recent result, a few frames old
+    float last_milliseconds() const { return last_milliseconds_; }
+
+private:
+    static constexpr auto QueryCount = 4;
+
+    std::string name_;
+    GLuint queries_[QueryCount];
+    int current_ = 0;
+    int pending_ = 0;
+    float last_milliseconds_ = 0.0f;
+};
+
+} // namespace gl
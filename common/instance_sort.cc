@@ -0,0 +1,145 @@
+#include "instance_sort.h"
+
+#include "panic.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <utility>
+
+namespace gl {
+
+namespace {
+
+// SSBO bindings of instance_sort.comp
+constexpr auto InstanceBinding = 0;
+constexpr auto KeysInBinding = 1;
+constexpr auto IndicesInBinding = 2;
+constexpr auto KeysOutBinding = 3;
+constexpr auto IndicesOutBinding = 5;
+constexpr auto BucketOffsetsBinding = 6;
+constexpr auto CommandBinding = 7;
+
+int group_count(int instance_count, int group_size)
+{
+    return (instance_count + group_size - 1) / group_size;
+}
+
+} // namespace
+
+instance_sort::instance_sort(int max_instances, int stride, int position_offset)
+    : sorted_indices_(GL_SHADER_STORAGE_BUFFER, max_instances, buffer_storage::stream)
+    , command_(GL_DRAW_INDIRECT_BUFFER, 1, buffer_storage::stream)
+    , keys_(GL_SHADER_STORAGE_BUFFER, max_instances, buffer_storage::immutable)
+    , scratch_keys_(GL_SHADER_STORAGE_BUFFER, max_instances, buffer_storage::immutable)
+    , scratch_indices_(GL_SHADER_STORAGE_BUFFER, max_instances, buffer_storage::immutable)
+    , bucket_offsets_(GL_SHADER_STORAGE_BUFFER, (1 << RadixBits) * group_count(max_instances, GroupSize),
+                      buffer_storage::immutable)
+{
+    if (stride % 4 != 0 || position_offset % 4 != 0 || position_offset + 12 > stride)
+        panic("invalid instance layout, position at %d of %d bytes\n", position_offset, stride);
+
+    const std::vector<std::string> defines = { "GROUP_SIZE " + std::to_string(GroupSize),
+                                               "RADIX_BITS " + std::to_string(RadixBits) };
+    const auto build = [&defines](shader_program &program, std::vector<std::string> kernel_defines) {
+        kernel_defines.insert(kernel_defines.end(), defines.begin(), defines.end());
+        program.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/instance_sort.comp", kernel_defines);
+        program.link();
+    };
+    build(key_program_, { "SORT_KEYS", "INSTANCE_STRIDE " + std::to_string(stride / 4),
+                          "POSITION_OFFSET " + std::to_string(position_offset / 4) });
+    build(histogram_program_, { "SORT_HISTOGRAM" });
+    build(scan_program_, { "SORT_SCAN" });
+    build(scatter_program_, { "SORT_SCATTER" });
+}
+
+void instance_sort::sort(GLuint instance_buffer, int instance_count, const glm::mat4 &model_view,
+                         int vertex_count) const
+{
+    if (instance_count > max_instances())
+        panic("too many instances to sort: %d, room for %d\n", instance_count, max_instances());
+
+    const auto groups = group_count(instance_count, GroupSize);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, InstanceBinding, instance_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KeysOutBinding, keys_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndicesOutBinding, sorted_indices_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, command_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BucketOffsetsBinding, bucket_offsets_.handle());
+
+    key_program_.bind();
+    key_program_.set_uniform("modelViewMatrix", model_view);
+    key_program_.set_uniform("instanceCount", instance_count);
+    key_program_.set_uniform("vertexCount", vertex_count);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // an even number of passes, so the result ends up back in keys_ and sorted_indices_
+    static_assert((32 / RadixBits) % 2 == 0);
+    const buffer<GLuint> *keys[] = { &keys_, &scratch_keys_ };
+    const buffer<GLuint> *indices[] = { &sorted_indices_, &scratch_indices_ };
+
+    for (int shift = 0; shift < 32; shift += RadixBits) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KeysInBinding, keys[0]->handle());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndicesInBinding, indices[0]->handle());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KeysOutBinding, keys[1]->handle());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndicesOutBinding, indices[1]->handle());
+
+        histogram_program_.bind();
+        histogram_program_.set_uniform("instanceCount", instance_count);
+        histogram_program_.set_uniform("shift", shift);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        scan_program_.bind();
+        scan_program_.set_uniform("groupCount", groups);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        scatter_program_.bind();
+        scatter_program_.set_uniform("instanceCount", instance_count);
+        scatter_program_.set_uniform("shift", shift);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        std::swap(keys[0], keys[1]);
+        std::swap(indices[0], indices[1]);
+    }
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void instance_sort::sort_on_cpu(const std::vector<glm::vec3> &positions, const glm::mat4 &model_view,
+                                int vertex_count) const
+{
+    const int instance_count = positions.size();
+    if (instance_count > max_instances())
+        panic("too many instances to sort: %d, room for %d\n", instance_count, max_instances());
+
+    // back to front is ascending view space z
+    depths_.resize(instance_count);
+    std::transform(positions.begin(), positions.end(), depths_.begin(),
+                   [&model_view](const glm::vec3 &position) { return (model_view * glm::vec4(position, 1)).z; });
+    order_.resize(instance_count);
+    std::iota(order_.begin(), order_.end(), 0);
+    std::sort(order_.begin(), order_.end(), [this](GLuint a, GLuint b) { return depths_[a] < depths_[b]; });
+
+    sorted_indices_.set_sub_data(0, order_.data(), instance_count);
+    const draw_arrays_indirect_command command = { static_cast<GLuint>(vertex_count),
+                                                   static_cast<GLuint>(instance_count), 0, 0 };
+    command_.set_sub_data(0, &command, 1);
+}
+
+void instance_sort::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SortedIndexBinding, sorted_indices_.handle());
+}
+
+void instance_sort::draw_arrays(GLenum mode) const
+{
+    bind();
+    command_.bind();
+    glDrawArraysIndirect(mode, nullptr);
+}
+
+} // namespace gl
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "buffer.h"
+#include "shader_program.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gl {
+
+// std430 layout of a glDrawArraysIndirect command
+struct draw_arrays_indirect_command
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+};
+
+// Orders instances back to front for blending. sort() does it on the GPU: a compute
+// pass turns the view space depth of every instance into a key, and a least significant
+// digit radix sort (four 8 bit passes, each a histogram, a scan and a stable scatter)
+// sorts the instance indices by it, so nothing goes back to the CPU. sort_on_cpu() does
+// the same with std::sort from positions the CPU already has. Either way the result is
+// the buffer of sorted indices and an indirect draw of all the instances; vertex shaders
+// include common/shaders/sorted_instances.glsl and look their instance up through
+// sortedInstance(gl_InstanceID).
+class instance_sort : private noncopyable
+{
+public:
+    // SSBO binding of the sorted indices, keep in sync with sorted_instances.glsl
+    static constexpr auto SortedIndexBinding = 4;
+
+    // Instance data is read stride bytes apart, with the position as three floats at
+    // position_offset; both must be multiples of 4.
+    instance_sort(int max_instances, int stride, int position_offset);
+
+    int max_instances() const { return sorted_indices_.size(); }
+
+    // Sorts the first instance_count instances of instance_buffer, drawn with
+    // model_view, and sets up a draw of vertex_count vertices per instance.
+    void sort(GLuint instance_buffer, int instance_count, const glm::mat4 &model_view, int vertex_count) const;
+
+    // The same from positions on the CPU, one per instance.
+    void sort_on_cpu(const std::vector<glm::vec3> &positions, const glm::mat4 &model_view, int vertex_count) const;
+
+    // binds the sorted indices
+    void bind() const;
+
+    // binds the sorted indices and draws every instance; the vertex array must be bound
+    void draw_arrays(GLenum mode) const;
+
+    const buffer<GLuint> &sorted_indices() const { return sorted_indices_; }
+
+private:
+    static constexpr auto GroupSize = 256; // instances per workgroup, and radix buckets
+    static constexpr auto RadixBits = 8;
+    static_assert(GroupSize == 1 << RadixBits);
+
+    // written by the compute passes or from the CPU
+    buffer<GLuint> sorted_indices_;
+    buffer<draw_arrays_indirect_command> command_;
+    // sort keys, ping-ponged with the indices between radix passes
+    buffer<GLuint> keys_;
+    buffer<GLuint> scratch_keys_;
+    buffer<GLuint> scratch_indices_;
+    buffer<GLuint> bucket_offsets_; // by bucket, then workgroup
+    shader_program key_program_;
+    shader_program histogram_program_;
+    shader_program scan_program_;
+    shader_program scatter_program_;
+    mutable std::vector<float> depths_;
+    mutable std::vector<GLuint> order_;
+};
+
+} // namespace gl
@@ -0,0 +1,80 @@
+#include "light_clusters.h"
+
+#include "panic.h"
+
+namespace gl {
+
+namespace {
+
+constexpr auto CullGroupSize = 128; // clusters per workgroup, and lights per batch
+
+int cluster_count(const glm::ivec3 &grid)
+{
+    return grid.x * grid.y * grid.z;
+}
+
+} // namespace
+
+light_clusters::light_clusters(int max_lights, int max_lights_per_cluster, const glm::ivec3 &grid)
+    : grid_(grid)
+    , max_lights_per_cluster_(max_lights_per_cluster)
+    , light_buffer_(GL_SHADER_STORAGE_BUFFER, max_lights, buffer_storage::stream)
+    , count_buffer_(GL_SHADER_STORAGE_BUFFER, cluster_count(grid), buffer_storage::immutable)
+    , index_buffer_(GL_SHADER_STORAGE_BUFFER, cluster_count(grid) * max_lights_per_cluster, buffer_storage::immutable)
+{
+    if (grid.x < 1 || grid.y < 1 || grid.z < 1)
+        panic("invalid light cluster grid %dx%dx%d\n", grid.x, grid.y, grid.z);
+
+    auto defines = shader_defines();
+    defines.push_back("CULL_GROUP_SIZE " + std::to_string(CullGroupSize));
+    cull_program_.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/light_clusters.comp", defines);
+    cull_program_.link();
+}
+
+void light_clusters::set_lights(const std::vector<point_light> &lights)
+{
+    if (lights.size() > light_buffer_.size())
+        panic("too many point lights: %d, room for %d\n", static_cast<int>(lights.size()), max_lights());
+    light_count_ = lights.size();
+    light_buffer_.set_sub_data(0, lights.data(), lights.size());
+}
+
+void light_clusters::update(const glm::mat4 &view, const glm::mat4 &projection, float near, float far)
+{
+    near_ = near;
+    far_ = far;
+
+    cull_program_.bind();
+    cull_program_.set_uniform("viewMatrix", view);
+    cull_program_.set_uniform("inverseProjectionMatrix", glm::inverse(projection));
+    cull_program_.set_uniform("clusterDepthRange", glm::vec2(near_, far_));
+    cull_program_.set_uniform("lightCount", light_count_);
+
+    bind();
+    glDispatchCompute((cluster_count(grid_) + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+    // the lists are read by fragment shaders
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void light_clusters::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PointLightBinding, light_buffer_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ClusterCountBinding, count_buffer_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ClusterIndexBinding, index_buffer_.handle());
+}
+
+std::vector<std::string> light_clusters::shader_defines() const
+{
+    return { "CLUSTER_GRID_X " + std::to_string(grid_.x), "CLUSTER_GRID_Y " + std::to_string(grid_.y),
+             "CLUSTER_GRID_Z " + std::to_string(grid_.z),
+             "MAX_CLUSTER_LIGHTS " + std::to_string(max_lights_per_cluster_) };
+}
+
+void light_clusters::set_uniforms(const shader_program &program, int viewport_width, int viewport_height) const
+{
+    program.set_uniform("clusterViewport", glm::vec2(viewport_width, viewport_height));
+    program.set_uniform("clusterDepthRange", glm::vec2(near_, far_));
+}
+
+} // namespace gl
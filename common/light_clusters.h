@@ -0,0 +1,66 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "buffer.h"
+#include "shader_program.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace gl {
+
+// std430 layout of the PointLights buffer
+struct point_light
+{
+    glm::vec4 position_radius; // world space position, radius of influence in w
+    glm::vec4 color;
+};
+
+// Clustered light culling (Olsson et al., "Clustered Deferred and Forward Shading"):
+// the view frustum is split into a grid of froxels, screen space tiles by
+// exponentially spaced depth slices, and a compute pass lists the point lights whose
+// sphere touches each one. Fragment shaders include common/shaders/light_clusters.glsl,
+// built with shader_defines(), and only loop over the lights of their own cluster.
+class light_clusters : private noncopyable
+{
+public:
+    // SSBO bindings, keep in sync with light_clusters.glsl
+    static constexpr auto PointLightBinding = 1;
+    static constexpr auto ClusterCountBinding = 2;
+    static constexpr auto ClusterIndexBinding = 3;
+
+    // Lights past max_lights_per_cluster in a crowded cluster are dropped.
+    light_clusters(int max_lights, int max_lights_per_cluster = 128, const glm::ivec3 &grid = glm::ivec3(16, 16, 24));
+
+    int max_lights() const { return light_buffer_.size(); }
+
+    void set_lights(const std::vector<point_light> &lights);
+
+    // Rebins the lights for this camera. Slices are spread over [near, far] of view
+    // space depth; fragments past far end up in the last slice.
+    void update(const glm::mat4 &view, const glm::mat4 &projection, float near, float far);
+
+    // the three buffers, at their bindings
+    void bind() const;
+
+    // #defines for programs that include light_clusters.glsl
+    std::vector<std::string> shader_defines() const;
+
+    // viewport and depth range uniforms of light_clusters.glsl
+    void set_uniforms(const shader_program &program, int viewport_width, int viewport_height) const;
+
+private:
+    glm::ivec3 grid_;
+    int max_lights_per_cluster_;
+    int light_count_ = 0;
+    float near_ = 0.1f;
+    float far_ = 100.0f;
+    buffer<point_light> light_buffer_;
+    buffer<GLuint> count_buffer_;
+    buffer<GLuint> index_buffer_;
+    shader_program cull_program_;
+};
+
+} // namespace gl
@@ -0,0 +1,165 @@
+#include "light_frustum.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace gl {
+
+std::array<glm::vec3, 8> bounding_box::corners() const
+{
+    std::array<glm::vec3, 8> result;
+    for (int i = 0; i < 8; ++i)
+        result[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    return result;
+}
+
+bounding_box bounding_box::transformed(const glm::mat4 &m) const
+{
+    bounding_box result;
+    for (const auto &c : corners())
+        result.add(glm::vec3(m * glm::vec4(c, 1.0f)));
+    return result;
+}
+
+namespace {
+
+// camera frustum corners moved into the space `to_space` maps world space to
+bounding_box frustum_bounds(const glm::mat4 &view_projection, const glm::mat4 &to_space)
+{
+    const auto inverse = to_space * glm::inverse(view_projection);
+
+    bounding_box result;
+    for (const auto &c : bounding_box{ glm::vec3(-1), glm::vec3(1) }.corners()) {
+        const auto p = inverse * glm::vec4(c, 1.0f);
+        result.add(glm::vec3(p) / p.w);
+    }
+    return result;
+}
+
+// Union of the visible parts of the receivers in `to_space`. Falls back to all of them
+// when the camera sees none, so the map is at least valid when it comes back.
+bounding_box visible_receivers(const glm::mat4 &camera_view_projection, const glm::mat4 &to_space,
+                               const std::vector<bounding_box> &receivers)
+{
+    const auto frustum = frustum_bounds(camera_view_projection, to_space);
+
+    bounding_box focus;
+    for (const auto &receiver : receivers) {
+        const auto visible = bounding_box::intersection(receiver.transformed(to_space), frustum);
+        if (!visible.empty())
+            focus.add(visible);
+    }
+
+    if (focus.empty()) {
+        for (const auto &receiver : receivers)
+            focus.add(receiver.transformed(to_space));
+    }
+
+    return focus;
+}
+
+glm::vec3 up_vector(const glm::vec3 &direction)
+{
+    return std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+}
+
+} // namespace
+
+float screen_coverage(const glm::mat4 &camera_view_projection, const bounding_box &box)
+{
+    // corners behind the camera would project mirrored, clamp them to the near plane
+    // instead of clipping properly; it only needs to be a rough estimate
+    bounding_box ndc;
+    bool in_front = false;
+    for (const auto &c : box.corners()) {
+        const auto p = camera_view_projection * glm::vec4(c, 1.0f);
+        ndc.add(glm::vec3(p) / std::max(p.w, 1e-4f));
+        in_front = in_front || p.w > 0.0f;
+    }
+    if (!in_front)
+        return 0.0f;
+
+    const auto visible = bounding_box::intersection(ndc, bounding_box{ glm::vec3(-1), glm::vec3(1) });
+    if (visible.empty())
+        return 0.0f;
+    return 0.25f * (visible.max.x - visible.min.x) * (visible.max.y - visible.min.y);
+}
+
+light_frustum fit_directional_light(const glm::vec3 &direction, const glm::mat4 &camera_view_projection,
+                                    const std::vector<bounding_box> &casters,
+                                    const std::vector<bounding_box> &receivers, int size)
+{
+    const auto forward = glm::normalize(direction);
+    const auto view = glm::lookAt(glm::vec3(0), forward, up_vector(forward));
+
+    // light space looks down -z, larger z is closer to the light
+    const auto focus = visible_receivers(camera_view_projection, view, receivers);
+
+    // Casters only matter if they're in front of the focus region; anything off to the
+    // side can't throw a shadow into it along the light direction.
+    auto near_z = focus.max.z;
+    for (const auto &caster : casters) {
+        const auto box = caster.transformed(view);
+        if (box.max.x >= focus.min.x && box.min.x <= focus.max.x && box.max.y >= focus.min.y &&
+            box.min.y <= focus.max.y)
+            near_z = std::max(near_z, box.max.z);
+    }
+    const auto far_z = focus.min.z;
+    const auto depth_margin = 0.01f * (near_z - far_z) + 0.001f;
+
+    // Quantize the extent to 1/16 of the next power of two, so that the texel size only
+    // changes in discrete steps rather than every frame.
+    auto extent = std::max({ focus.max.x - focus.min.x, focus.max.y - focus.min.y, 0.001f });
+    const auto step = std::exp2(std::ceil(std::log2(extent))) / 16.0f;
+    extent = std::ceil(extent / step) * step;
+
+    // Snap the corner to whole texels; one texel of slack covers what the snapping
+    // takes away on the other side.
+    const auto texel = extent / (size - 1);
+    const auto center = 0.5f * (focus.min + focus.max);
+    const auto left = std::floor((center.x - 0.5f * extent) / texel) * texel;
+    const auto bottom = std::floor((center.y - 0.5f * extent) / texel) * texel;
+    const auto width = texel * size;
+
+    const auto projection =
+            glm::ortho(left, left + width, bottom, bottom + width, -near_z - depth_margin, -far_z + depth_margin);
+
+    return { view, projection };
+}
+
+light_frustum fit_spot_light(const glm::vec3 &position, const glm::mat4 &camera_view_projection,
+                             const std::vector<bounding_box> &casters, const std::vector<bounding_box> &receivers,
+                             float min_near)
+{
+    // aim at the middle of the visible receivers...
+    const auto target = visible_receivers(camera_view_projection, glm::mat4(1.0f), receivers);
+    const auto forward = glm::normalize(0.5f * (target.min + target.max) - position);
+    const auto view = glm::lookAt(position, position + forward, up_vector(forward));
+
+    // ...and open the cone just enough to contain them
+    const auto focus = visible_receivers(camera_view_projection, view, receivers);
+
+    float max_tan = 0;
+    for (const auto &c : focus.corners()) {
+        const auto depth = std::max(-c.z, min_near);
+        max_tan = std::max({ max_tan, std::abs(c.x) / depth, std::abs(c.y) / depth });
+    }
+    const auto fov = std::min(2.0f * std::atan(max_tan), glm::radians(170.0f));
+
+    auto near = -focus.max.z;
+    for (const auto &caster : casters) {
+        const auto box = caster.transformed(view);
+        if (box.min.z < 0)
+            near = std::min(near, -box.max.z);
+    }
+    near = std::max(near, min_near);
+    const auto far = std::max(-focus.min.z, near + min_near);
+
+    const auto projection = glm::perspective(fov, 1.0f, near, far);
+
+    return { view, projection };
+}
+
+} // namespace gl
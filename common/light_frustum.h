@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+namespace gl {
+
+struct bounding_box
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    static bounding_box from_sphere(const glm::vec3 &center, float radius)
+    {
+        return { center - glm::vec3(radius), center + glm::vec3(radius) };
+    }
+
+    bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    void add(const glm::vec3 &p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void add(const bounding_box &other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    std::array<glm::vec3, 8> corners() const;
+
+    // box around the transformed corners
+    bounding_box transformed(const glm::mat4 &m) const;
+
+    static bounding_box intersection(const bounding_box &a, const bounding_box &b)
+    {
+        return { glm::max(a.min, b.min), glm::min(a.max, b.max) };
+    }
+};
+
+struct light_frustum
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+
+    glm::mat4 view_projection() const { return projection * view; }
+};
+
+// Fraction of the screen covered by the projection of box, clipped to the viewport; 0
+// when the box is entirely behind the camera. For sizing shadow maps.
+float screen_coverage(const glm::mat4 &camera_view_projection, const bounding_box &box);
+
+// Tight orthographic projection for a directional light. Only the part of the receivers
+// the camera can see (camera frustum and receiver boxes intersected in light space) is
+// covered, snapped to whole texels of a size x size map and to a quantized extent so
+// that it doesn't shimmer as the camera moves. Near and far are pulled in to the
+// closest caster in front of that region and to its back, which is all the depth
+// range the map needs.
+light_frustum fit_directional_light(const glm::vec3 &direction, const glm::mat4 &camera_view_projection,
+                                    const std::vector<bounding_box> &casters,
+                                    const std::vector<bounding_box> &receivers, int size);
+
+// Same for a spot light at `position`: a square perspective projection aimed at the
+// visible receivers, with the field of view just wide enough to contain them. Texels
+// aren't snapped, perspective texels have no fixed world space size; near is clamped
+// to min_near.
+light_frustum fit_spot_light(const glm::vec3 &position, const glm::mat4 &camera_view_projection,
+                             const std::vector<bounding_box> &casters, const std::vector<bounding_box> &receivers,
+                             float min_near = 0.05f);
+
+} // namespace gl
@@ -0,0 +1,305 @@
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+
+namespace gl {
+
+namespace {
+
+// symmetric 4x4 matrix, upper triangle stored row by row
+using quadric = std::array<double, 10>;
+
+quadric plane_quadric(const glm::vec3 &normal, float d, double weight)
+{
+    const double a = normal.x, b = normal.y, c = normal.z;
+    return { weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+             weight * b * b, weight * b * c, weight * b * d,
+             weight * c * c, weight * c * d,
+             weight * d * d };
+}
+
+void accumulate(quadric &q, const quadric &other)
+{
+    for (std::size_t i = 0; i < q.size(); ++i)
+        q[i] += other[i];
+}
+
+double evaluate(const quadric &q, const glm::vec3 &v)
+{
+    const double x = v.x, y = v.y, z = v.z;
+    const double e = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+                   + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+                   + q[7] * z * z + 2 * q[8] * z
+                   + q[9];
+    return std::max(e, 0.0);
+}
+
+struct collapse
+{
+    double cost;
+    unsigned from, to;
+    unsigned from_version, to_version;
+
+    bool operator>(const collapse &other) const { return cost > other.cost; }
+};
+
+// boundary edges get a perpendicular constraint plane so that holes (e.g. the monkey's
+// eyes) don't get eaten away
+constexpr double BoundaryWeight = 100.0;
+
+class simplifier
+{
+public:
+    simplifier(const std::vector<glm::vec3> &positions, const std::vector<unsigned> &indices)
+        : positions_(positions)
+        , quadrics_(positions.size(), quadric{})
+        , vertex_triangles_(positions.size())
+        , versions_(positions.size(), 0)
+    {
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const auto t = static_cast<unsigned>(triangles_.size());
+            triangles_.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+            removed_.push_back(false);
+            for (auto v : triangles_.back())
+                vertex_triangles_[v].push_back(t);
+        }
+        live_triangles_ = triangles_.size();
+
+        initialize_quadrics();
+        initialize_collapses();
+    }
+
+    std::vector<unsigned> run(std::size_t target_index_count, float *error)
+    {
+        double max_cost = 0;
+
+        while (live_triangles_ * 3 > target_index_count && !queue_.empty()) {
+            const auto c = queue_.top();
+            queue_.pop();
+
+            if (c.from_version != versions_[c.from] || c.to_version != versions_[c.to])
+                continue; // stale
+
+            if (!apply(c.from, c.to))
+                continue;
+
+            max_cost = std::max(max_cost, c.cost);
+        }
+
+        if (error)
+            *error = static_cast<float>(max_cost);
+
+        std::vector<unsigned> result;
+        result.reserve(live_triangles_ * 3);
+        for (std::size_t i = 0; i < triangles_.size(); ++i) {
+            if (!removed_[i])
+                result.insert(result.end(), triangles_[i].begin(), triangles_[i].end());
+        }
+        return result;
+    }
+
+private:
+    static std::uint64_t edge_key(unsigned a, unsigned b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return (static_cast<std::uint64_t>(a) << 32) | b;
+    }
+
+    glm::vec3 face_normal(const std::array<unsigned, 3> &t) const
+    {
+        const auto &p0 = positions_[t[0]];
+        const auto &p1 = positions_[t[1]];
+        const auto &p2 = positions_[t[2]];
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+
+    void initialize_quadrics()
+    {
+        std::unordered_map<std::uint64_t, int> edge_use;
+
+        for (const auto &t : triangles_) {
+            for (int i = 0; i < 3; ++i)
+                ++edge_use[edge_key(t[i], t[(i + 1) % 3])];
+        }
+
+        for (const auto &t : triangles_) {
+            const auto n = face_normal(t);
+            const auto double_area = glm::length(n);
+            if (double_area == 0)
+                continue;
+            const auto normal = n / double_area;
+
+            const auto q = plane_quadric(normal, -glm::dot(normal, positions_[t[0]]), 0.5 * double_area);
+            for (auto v : t)
+                accumulate(quadrics_[v], q);
+
+            for (int i = 0; i < 3; ++i) {
+                const auto a = t[i];
+                const auto b = t[(i + 1) % 3];
+                if (edge_use[edge_key(a, b)] != 1)
+                    continue;
+
+                const auto edge = positions_[b] - positions_[a];
+                const auto edge_length = glm::length(edge);
+                if (edge_length == 0)
+                    continue;
+
+                const auto side = glm::normalize(glm::cross(edge, normal));
+                const auto bq = plane_quadric(side, -glm::dot(side, positions_[a]),
+                                              BoundaryWeight * edge_length * edge_length);
+                accumulate(quadrics_[a], bq);
+                accumulate(quadrics_[b], bq);
+            }
+        }
+    }
+
+    void initialize_collapses()
+    {
+        std::unordered_map<std::uint64_t, bool> seen;
+        for (const auto &t : triangles_) {
+            for (int i = 0; i < 3; ++i) {
+                const auto a = t[i];
+                const auto b = t[(i + 1) % 3];
+                if (seen.emplace(edge_key(a, b), true).second)
+                    push_collapse(a, b);
+            }
+        }
+    }
+
+    void push_collapse(unsigned a, unsigned b)
+    {
+        auto q = quadrics_[a];
+        accumulate(q, quadrics_[b]);
+
+        // collapse onto whichever endpoint introduces the least error
+        const auto cost_to_b = evaluate(q, positions_[b]);
+        const auto cost_to_a = evaluate(q, positions_[a]);
+        if (cost_to_b <= cost_to_a)
+            queue_.push({ cost_to_b, a, b, versions_[a], versions_[b] });
+        else
+            queue_.push({ cost_to_a, b, a, versions_[b], versions_[a] });
+    }
+
+    bool apply(unsigned from, unsigned to)
+    {
+        // reject collapses that would flip any of the surviving triangles
+
+        for (auto t : vertex_triangles_[from]) {
+            if (removed_[t])
+                continue;
+            auto triangle = triangles_[t];
+            if (std::find(triangle.begin(), triangle.end(), to) != triangle.end())
+                continue;
+            const auto before = face_normal(triangle);
+            std::replace(triangle.begin(), triangle.end(), from, to);
+            const auto after = face_normal(triangle);
+            if (glm::dot(before, after) <= 0)
+                return false;
+        }
+
+        for (auto t : vertex_triangles_[from]) {
+            if (removed_[t])
+                continue;
+            auto &triangle = triangles_[t];
+            if (std::find(triangle.begin(), triangle.end(), to) != triangle.end()) {
+                removed_[t] = true;
+                --live_triangles_;
+            } else {
+                std::replace(triangle.begin(), triangle.end(), from, to);
+                vertex_triangles_[to].push_back(t);
+            }
+        }
+        vertex_triangles_[from].clear();
+
+        accumulate(quadrics_[to], quadrics_[from]);
+        ++versions_[from];
+        ++versions_[to];
+
+        std::vector<unsigned> neighbors;
+        for (auto t : vertex_triangles_[to]) {
+            if (removed_[t])
+                continue;
+            for (auto v : triangles_[t]) {
+                if (v != to)
+                    neighbors.push_back(v);
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (auto v : neighbors)
+            push_collapse(to, v);
+
+        return true;
+    }
+
+    const std::vector<glm::vec3> &positions_;
+    std::vector<std::array<unsigned, 3>> triangles_;
+    std::vector<bool> removed_;
+    std::size_t live_triangles_;
+    std::vector<quadric> quadrics_;
+    std::vector<std::vector<unsigned>> vertex_triangles_;
+    std::vector<unsigned> versions_;
+    std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse>> queue_;
+};
+
+} // namespace
+
+std::vector<unsigned> simplify_mesh(const std::vector<glm::vec3> &positions, const std::vector<unsigned> &indices,
+                                    std::size_t target_index_count, float *error)
+{
+    return simplifier(positions, indices).run(target_index_count, error);
+}
+
+std::vector<lod_level> build_lod_chain(const std::vector<glm::vec3> &positions, const std::vector<unsigned> &indices,
+                                       int max_levels, float ratio)
+{
+    constexpr const auto MinTriangles = 16;
+
+    std::vector<lod_level> levels;
+    levels.push_back({ indices, 0.0f });
+
+    while (levels.size() < static_cast<std::size_t>(max_levels)) {
+        const auto &prev = levels.back().indices;
+        const auto target = static_cast<std::size_t>(prev.size() / 3 * ratio) * 3;
+        if (target < MinTriangles * 3)
+            break;
+
+        float error;
+        auto simplified = simplify_mesh(positions, prev, target, &error);
+        if (simplified.size() > prev.size() * 9 / 10)
+            break;
+
+        levels.push_back({ std::move(simplified), std::max(error, levels.back().error) });
+    }
+
+    return levels;
+}
+
+float projected_size(const glm::mat4 &view_projection, const glm::vec3 &center, float radius, int viewport_height)
+{
+    const auto w = (view_projection * glm::vec4(center, 1.0f)).w;
+    if (w <= 1e-4f)
+        return static_cast<float>(viewport_height); // camera is inside the sphere
+
+    // length of the y row is the projection's vertical scale times any uniform scale
+    // in the model or view transforms
+    const auto scale = glm::length(glm::vec3(view_projection[0][1], view_projection[1][1], view_projection[2][1]));
+
+    return radius * scale / w * viewport_height;
+}
+
+int select_lod(float projected_size, float full_detail_size, int level_count, int bias)
+{
+    int level = 0;
+    if (projected_size < full_detail_size)
+        level = static_cast<int>(std::log2(full_detail_size / std::max(projected_size, 1e-3f)));
+    return std::clamp(level + bias, 0, level_count - 1);
+}
+
+} // namespace gl
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace gl {
+
+struct lod_level
+{
+    std::vector<unsigned> indices;
+    float error; // largest quadric error introduced while simplifying to this level
+};
+
+// Simplifies an indexed triangle list with quadric error metrics (Garland/Heckbert)
+// until at most target_index_count indices are left. Edges are collapsed onto one of
+// their endpoints, so the result still indexes into `positions`.
+std::vector<unsigned> simplify_mesh(const std::vector<glm::vec3> &positions, const std::vector<unsigned> &indices,
+                                    std::size_t target_index_count, float *error = nullptr);
+
+// Level 0 is the original mesh; every following level has roughly `ratio` times the
+// triangles of the previous one. Stops early once the simplifier can't make progress.
+std::vector<lod_level> build_lod_chain(const std::vector<glm::vec3> &positions, const std::vector<unsigned> &indices,
+                                       int max_levels, float ratio = 0.5f);
+
+// Height in pixels covered by a bounding sphere (given in the space view_projection
+// transforms from) on a viewport viewport_height pixels tall.
+float projected_size(const glm::mat4 &view_projection, const glm::vec3 &center, float radius, int viewport_height);
+
+// Full detail while the object covers at least full_detail_size pixels, one level
+// coarser every time the size halves. A positive bias picks coarser levels, e.g. for
+// shadow passes.
+int select_lod(float projected_size, float full_detail_size, int level_count, int bias = 0);
+
+} // namespace gl
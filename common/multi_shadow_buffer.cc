@@ -1,28 +1,31 @@
 #include "multi_shadow_buffer.h"
 
+#include "caps.h"
+#include "framebuffer.h"
+
 namespace gl {
 
 multi_shadow_buffer::multi_shadow_buffer(int width, int height, int layers)
-    : width_{ width }
-    , height_{ height }
-    , layers_{ layers }
-{
-    glGenTextures(1, &texture_id_);
-
-    fbo_id_.resize(layers);
-    glGenFramebuffers(layers, fbo_id_.data());
-
-    bind_texture();
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, width_, height_, layers_, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    unbind_texture();
-
-    for (int i = 0; i < layers; ++i)
+    : multi_shadow_buffer(make_desc(width, height, layers))
+{
+}
+
+multi_shadow_buffer::multi_shadow_buffer(const shadow_buffer_desc &desc)
+    : desc_{ desc }
+{
+    texture_id_ = detail::create_depth_texture(GL_TEXTURE_2D_ARRAY, desc_);
+
+    fbo_id_.resize(desc_.layers);
+
+    if (caps().direct_state_access) {
+        init_dsa();
+        return;
+    }
+
+    glGenFramebuffers(desc_.layers, fbo_id_.data());
+    glGenFramebuffers(1, &layered_fbo_id_);
+
+    for (int i = 0; i < desc_.layers; ++i)
     {
         bind(i);
         glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0, i);
@@ -30,11 +33,43 @@ multi_shadow_buffer::multi_shadow_buffer(int width, int height, int layers)
         glReadBuffer(GL_NONE);
         unbind();
     }
+
+    bind_layered();
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    unbind();
+}
+
+shadow_buffer_desc multi_shadow_buffer::make_desc(int width, int height, int layers)
+{
+    shadow_buffer_desc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.layers = layers;
+    return desc;
+}
+
+void multi_shadow_buffer::init_dsa()
+{
+    glCreateFramebuffers(desc_.layers, fbo_id_.data());
+    for (int i = 0; i < desc_.layers; ++i)
+    {
+        glNamedFramebufferTextureLayer(fbo_id_[i], GL_DEPTH_ATTACHMENT, texture_id_, 0, i);
+        glNamedFramebufferDrawBuffer(fbo_id_[i], GL_NONE);
+        glNamedFramebufferReadBuffer(fbo_id_[i], GL_NONE);
+    }
+
+    glCreateFramebuffers(1, &layered_fbo_id_);
+    glNamedFramebufferTexture(layered_fbo_id_, GL_DEPTH_ATTACHMENT, texture_id_, 0);
+    glNamedFramebufferDrawBuffer(layered_fbo_id_, GL_NONE);
+    glNamedFramebufferReadBuffer(layered_fbo_id_, GL_NONE);
 }
 
 multi_shadow_buffer::~multi_shadow_buffer()
 {
-    glDeleteFramebuffers(layers_, fbo_id_.data());
+    glDeleteFramebuffers(desc_.layers, fbo_id_.data());
+    glDeleteFramebuffers(1, &layered_fbo_id_);
     glDeleteTextures(1, &texture_id_);
 }
 
@@ -43,9 +78,14 @@ void multi_shadow_buffer::bind(int layer) const
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_[layer]);
 }
 
+void multi_shadow_buffer::bind_layered() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, layered_fbo_id_);
+}
+
 void multi_shadow_buffer::unbind()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebuffer::unbind();
 }
 
 void multi_shadow_buffer::bind_texture() const
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "shadow_buffer_desc.h"
 
 #include <GL/glew.h>
 
@@ -11,24 +12,34 @@ namespace gl {
 class multi_shadow_buffer : private noncopyable
 {
 public:
+    explicit multi_shadow_buffer(const shadow_buffer_desc &desc);
     multi_shadow_buffer(int width, int height, int layers);
     ~multi_shadow_buffer();
 
     void bind(int layer) const;
     static void unbind();
 
+    // every layer attached at once; the layer a primitive lands in is picked with
+    // gl_Layer, and glClear clears all of them
+    void bind_layered() const;
+
     void bind_texture() const;
     void unbind_texture() const;
 
-    int width() const { return width_; }
-    int height() const { return height_; }
+    int width() const { return desc_.width; }
+    int height() const { return desc_.height; }
+    GLuint texture_handle() const { return texture_id_; }
+    int layers() const { return desc_.layers; }
+    const shadow_buffer_desc &desc() const { return desc_; }
 
 private:
-    int width_;
-    int height_;
-    int layers_;
+    static shadow_buffer_desc make_desc(int width, int height, int layers);
+    void init_dsa();
+
+    shadow_buffer_desc desc_;
     GLuint texture_id_;
     std::vector<GLuint> fbo_id_;
+    GLuint layered_fbo_id_;
 };
 
 } // namespace gl
@@ -0,0 +1,77 @@
+#include "reference_comparison.h"
+
+#include "framebuffer.h"
+#include "render_target_pool.h"
+#include "stats.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace gl {
+
+namespace {
+
+std::vector<GLubyte> read_pixels(const framebuffer &target)
+{
+    std::vector<GLubyte> pixels(target.width() * target.height() * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.handle());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.width(), target.height(), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+} // namespace
+
+reference_comparison::reference_comparison(std::string name)
+    : name_(std::move(name))
+{
+}
+
+void reference_comparison::render(int width, int height, const std::function<void()> &reference,
+                                  const std::function<void()> &checked) const
+{
+    const auto *screen = framebuffer::screen();
+
+    const auto draw = [width, height](const std::function<void()> &render) -> const framebuffer & {
+        const auto &target = render_targets().acquire({ width, height, GL_RGBA8, 1, GL_DEPTH24_STENCIL8 });
+        framebuffer::set_screen(&target);
+        framebuffer::unbind();
+        render();
+        return target;
+    };
+    const auto &reference_target = draw(reference);
+    const auto &checked_target = draw(checked);
+    framebuffer::set_screen(screen);
+
+    const auto expected = read_pixels(reference_target);
+    const auto actual = read_pixels(checked_target);
+
+    // alpha is left out, nothing reads the screen's
+    long total = 0;
+    int largest = 0;
+    for (std::size_t i = 0; i < expected.size(); i += 4) {
+        for (std::size_t j = i; j < i + 3; ++j) {
+            const auto difference = std::abs(static_cast<int>(expected[j]) - static_cast<int>(actual[j]));
+            total += difference;
+            largest = std::max(largest, difference);
+        }
+    }
+    const auto channels = static_cast<long>(width) * height * 3;
+    stats::add(name_ + " mean difference from reference (1/100 of 8 bit steps)", 100 * total / channels);
+    stats::add(name_ + " largest difference from reference (8 bit steps)", largest);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, checked_target.handle());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, screen ? screen->handle() : 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    framebuffer::unbind();
+
+    render_targets().release(checked_target);
+    render_targets().release(reference_target);
+}
+
+} // namespace gl
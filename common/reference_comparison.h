@@ -0,0 +1,27 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <string>
+
+namespace gl {
+
+// Checks an approximation against a reference rendering of the same frame. Both are
+// drawn into offscreen targets standing in for the screen, read back and compared, and
+// the mean and largest 8 bit color difference are reported to gl::stats under name.
+// The checked image is then copied to the screen. Reading back two frames stalls the
+// pipeline, so this is for verifying, not for timing.
+class reference_comparison : private noncopyable
+{
+public:
+    explicit reference_comparison(std::string name);
+
+    void render(int width, int height, const std::function<void()> &reference,
+                const std::function<void()> &checked) const;
+
+private:
+    std::string name_;
+};
+
+} // namespace gl
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "buffer.h"
+#include "geometry_arena.h"
+#include "shader_program.h"
+#include "stats.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace gl {
+
+// Collects draws of arena geometry and submits them sorted by state, one
+// glMultiDrawElementsIndirect per (program, arena, primitive) bucket.
+//
+// Per-draw constants (DrawDataT, laid out as the std430 struct the shaders declare)
+// are written to a shader storage buffer bound at draw_data_binding. Shaders index it
+// with gl_DrawIDARB (GL_ARB_shader_draw_parameters); each bucket gets its own range of
+// the buffer so that gl_DrawIDARB, which restarts at zero on every multi-draw, lines
+// up with the bucket's first draw.
+//
+// Anything that is constant across a bucket (view and projection matrices, lights...)
+// is still set as regular uniforms on the program before calling submit().
+template<typename DrawDataT>
+class render_queue : private noncopyable
+{
+public:
+    render_queue(std::size_t max_draws, GLuint draw_data_binding)
+        : max_draws_(max_draws)
+        , draw_data_binding_(draw_data_binding)
+    {
+        GLint alignment;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment_ = std::max<std::size_t>(alignment, 1);
+
+        commands_.reset(new buffer<draw_command>(GL_DRAW_INDIRECT_BUFFER, max_draws, buffer_storage::stream));
+        // worst case every draw starts a new, aligned, bucket
+        draw_data_.reset(new buffer<char>(GL_SHADER_STORAGE_BUFFER, max_draws * (sizeof(DrawDataT) + alignment_),
+                                          buffer_storage::stream));
+    }
+
+    // instance_count is for shaders that replicate a draw themselves (gl_InstanceID),
+    // e.g. once per cube shadow map face
+    template<typename VertexT, typename IndexT>
+    void push(const geometry_arena<VertexT, IndexT> &arena, GLenum mode, const shader_program &program,
+              const geometry_handle &handle, const DrawDataT &data, GLuint instance_count = 1)
+    {
+        if (packets_.size() == max_draws_)
+            panic("render queue full (%zu draws)\n", max_draws_);
+
+        packets_.push_back(
+                { &program, arena.vertex_array_handle(), mode, arena.index_type(), handle, data, instance_count });
+    }
+
+    void submit()
+    {
+        if (packets_.empty())
+            return;
+
+        // stable, so that draws sharing state keep their submission order (which matters
+        // for blending)
+        std::stable_sort(packets_.begin(), packets_.end(), [](const packet &a, const packet &b) {
+            return a.state_key() < b.state_key();
+        });
+
+        // build the command and draw data streams, one aligned range per bucket
+
+        struct bucket
+        {
+            std::size_t first_packet;
+            std::size_t packet_count;
+            std::size_t data_offset;
+        };
+        std::vector<bucket> buckets;
+
+        std::vector<draw_command> commands;
+        commands.reserve(packets_.size());
+
+        std::vector<char> data;
+
+        for (std::size_t i = 0; i < packets_.size(); ++i) {
+            const auto &p = packets_[i];
+
+            if (buckets.empty() || p.state_key() != packets_[buckets.back().first_packet].state_key()) {
+                data.resize((data.size() + alignment_ - 1) / alignment_ * alignment_);
+                buckets.push_back({ i, 0, data.size() });
+            }
+            ++buckets.back().packet_count;
+
+            const auto &h = p.handle;
+            commands.push_back({ static_cast<GLuint>(h.count), p.instance_count, h.first_index, h.base_vertex, 0 });
+
+            const auto offset = data.size();
+            data.resize(offset + sizeof(DrawDataT));
+            std::memcpy(data.data() + offset, &p.data, sizeof(DrawDataT));
+        }
+
+        commands_->set_sub_data(0, commands.data(), commands.size());
+        draw_data_->set_sub_data(0, data.data(), data.size());
+
+        commands_->bind();
+        int api_calls = 3;
+
+        for (const auto &b : buckets) {
+            const auto &first = packets_[b.first_packet];
+
+            first.program->bind();
+            glBindVertexArray(first.vao);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, draw_data_binding_, draw_data_->handle(), b.data_offset,
+                              b.packet_count * sizeof(DrawDataT));
+            glMultiDrawElementsIndirect(first.mode, first.index_type,
+                                        reinterpret_cast<const GLvoid *>(b.first_packet * sizeof(draw_command)),
+                                        b.packet_count, 0);
+            api_calls += 4;
+        }
+
+        commands_->unbind();
+
+        stats::add("render queue draws", packets_.size());
+        stats::add("render queue API calls", api_calls);
+
+        packets_.clear();
+    }
+
+private:
+    // matches the layout glMultiDrawElementsIndirect expects
+    struct draw_command
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+
+    struct packet
+    {
+        const shader_program *program;
+        GLuint vao;
+        GLenum mode;
+        GLenum index_type;
+        geometry_handle handle;
+        DrawDataT data;
+        GLuint instance_count;
+
+        auto state_key() const { return std::make_tuple(program->handle(), vao, mode, index_type); }
+    };
+
+    std::size_t max_draws_;
+    GLuint draw_data_binding_;
+    std::size_t alignment_;
+    std::vector<packet> packets_;
+    std::unique_ptr<buffer<draw_command>> commands_;
+    std::unique_ptr<buffer<char>> draw_data_;
+};
+
+} // namespace gl
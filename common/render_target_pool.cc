@@ -0,0 +1,126 @@
+#include "render_target_pool.h"
+
+#include "panic.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace gl {
+
+namespace {
+
+std::size_t texel_size(GLenum internal_format)
+{
+    switch (internal_format) {
+    case GL_NONE:
+        return 0;
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_RGBA8:
+    case GL_RGB10_A2:
+    case GL_R11F_G11F_B10F:
+    case GL_RG16F:
+    case GL_R32F:
+        return 4;
+    case GL_RGBA16F:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        panic("unknown render target format 0x%x\n", internal_format);
+        return 0;
+    }
+}
+
+std::size_t target_size(const render_target_desc &desc)
+{
+    return static_cast<std::size_t>(desc.width) * desc.height * desc.samples *
+           (texel_size(desc.internal_format) + texel_size(desc.depth_format));
+}
+
+} // namespace
+
+const framebuffer &render_target_pool::acquire(const render_target_desc &desc)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(),
+                           [&desc](const entry &entry) { return !entry.in_use && entry.desc == desc; });
+    if (it == entries_.end()) {
+        auto target_desc = framebuffer_desc::color_only(desc.width, desc.height, desc.internal_format);
+        target_desc.depth = { desc.depth_format, attachment_storage::renderbuffer };
+        target_desc.samples = desc.samples;
+
+        const auto bytes = target_size(desc);
+        entries_.push_back({ desc, std::make_unique<framebuffer>(target_desc), bytes, false, frame_ });
+        it = std::prev(entries_.end());
+
+        allocated_bytes_ += bytes;
+        peak_allocated_bytes_ = std::max(peak_allocated_bytes_, allocated_bytes_);
+    }
+
+    it->in_use = true;
+    it->last_used_frame = frame_;
+
+    in_use_bytes_ += it->bytes;
+    frame_peak_bytes_ = std::max(frame_peak_bytes_, in_use_bytes_);
+
+    return *it->target;
+}
+
+void render_target_pool::release(const framebuffer &target)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(),
+                           [&target](const entry &entry) { return entry.target.get() == &target; });
+    if (it == entries_.end() || !it->in_use)
+        panic("releasing a render target that wasn't acquired\n");
+
+    it->in_use = false;
+    in_use_bytes_ -= it->bytes;
+}
+
+void render_target_pool::end_frame()
+{
+    for (auto &entry : entries_)
+        entry.in_use = false;
+
+    const auto idle = [this](const entry &entry) { return frame_ - entry.last_used_frame > MaxIdleFrames; };
+    for (const auto &entry : entries_) {
+        if (idle(entry))
+            allocated_bytes_ -= entry.bytes;
+    }
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), idle), entries_.end());
+
+    if (!entries_.empty()) {
+        stats::add("render targets allocated (KB)", allocated_bytes_ / 1024);
+        stats::add("render targets peak in use (KB)", frame_peak_bytes_ / 1024);
+    }
+
+    last_frame_peak_bytes_ = frame_peak_bytes_;
+    in_use_bytes_ = 0;
+    frame_peak_bytes_ = 0;
+    ++frame_;
+}
+
+void render_target_pool::clear()
+{
+    entries_.clear();
+    allocated_bytes_ = 0;
+    in_use_bytes_ = 0;
+}
+
+render_target_pool &render_targets()
+{
+    static render_target_pool pool;
+    return pool;
+}
+
+} // namespace gl
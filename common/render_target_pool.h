@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "framebuffer.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace gl {
+
+struct render_target_desc
+{
+    int width;
+    int height;
+    GLenum internal_format = GL_RGBA8;
+    int samples = 1;
+    GLenum depth_format = GL_NONE; // a depth renderbuffer, if any
+
+    bool operator==(const render_target_desc &other) const
+    {
+        return width == other.width && height == other.height && internal_format == other.internal_format &&
+               samples == other.samples && depth_format == other.depth_format;
+    }
+};
+
+// Transient framebuffers shared by everything that renders within a frame. A target
+// released by one effect is handed to the next acquire() of the same description, so
+// passes that don't overlap in time alias the same memory. end_frame() takes back
+// whatever is still out and frees targets nobody asked for in a while (after a resize,
+// say).
+class render_target_pool : private noncopyable
+{
+public:
+    // frames a free target is kept around for
+    static constexpr auto MaxIdleFrames = 60;
+
+    // The contents are undefined, the previous user may have left anything in there.
+    const framebuffer &acquire(const render_target_desc &desc);
+    void release(const framebuffer &target);
+
+    // Recycles every target and reports the memory counters to gl::stats.
+    void end_frame();
+
+    // deletes every target, while the context is still there
+    void clear();
+
+    // estimated GPU memory of the targets allocated right now, and the most it has been
+    std::size_t allocated_bytes() const { return allocated_bytes_; }
+    std::size_t peak_allocated_bytes() const { return peak_allocated_bytes_; }
+
+    // most memory held by acquired targets at once during the last frame
+    std::size_t frame_peak_bytes() const { return last_frame_peak_bytes_; }
+
+private:
+    struct entry
+    {
+        render_target_desc desc;
+        std::unique_ptr<framebuffer> target;
+        std::size_t bytes;
+        bool in_use;
+        int last_used_frame;
+    };
+
+    std::vector<entry> entries_;
+    int frame_ = 0;
+    std::size_t allocated_bytes_ = 0;
+    std::size_t peak_allocated_bytes_ = 0;
+    std::size_t in_use_bytes_ = 0;
+    std::size_t frame_peak_bytes_ = 0;
+    std::size_t last_frame_peak_bytes_ = 0;
+};
+
+// The pool of the current context, emptied by window before it goes away.
+render_target_pool &render_targets();
+
+} // namespace gl
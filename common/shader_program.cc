@@ -5,6 +5,7 @@
 #include <array>
 #include <fstream>
 #include <sstream>
+#include <string>
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -32,6 +33,64 @@ static std::vector<char> load_file(const char *path)
     return data;
 }
 
+static std::string directory_of(const std::string &path)
+{
+    const auto slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static bool file_exists(const std::string &path)
+{
+    return std::ifstream(path).is_open();
+}
+
+// Expands `#include "file"` lines, looking for the file next to the including shader
+// first and in the shared shader directory (common/shaders) second.
+static std::string load_source(const std::string &path, int depth = 0)
+{
+    constexpr const auto MaxIncludeDepth = 16;
+    if (depth > MaxIncludeDepth)
+        panic("shader includes nested too deeply in %s\n", path.c_str());
+
+    std::istringstream source(load_file(path.c_str()).data());
+    std::string result;
+
+    std::string line;
+    while (std::getline(source, line)) {
+        const auto directive = line.find_first_not_of(" \t");
+        if (directive != std::string::npos && line.compare(directive, 8, "#include") == 0) {
+            const auto open = line.find('"', directive);
+            const auto close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos)
+                panic("malformed include in %s: %s\n", path.c_str(), line.c_str());
+            const auto name = line.substr(open + 1, close - open - 1);
+
+            auto include_path = directory_of(path) + name;
+            if (!file_exists(include_path))
+                include_path = std::string(COMMON_SHADER_DIR "/") + name;
+
+            result += load_source(include_path, depth + 1);
+        } else {
+            result += line;
+            result += '\n';
+        }
+    }
+
+    return result;
+}
+
+static std::string insert_defines(const std::string &source, const std::vector<std::string> &defines)
+{
+    std::string lines;
+    for (const auto &define : defines)
+        lines += "#define " + define + "\n";
+
+    // #version has to stay first
+    auto pos = source.find("#version");
+    pos = pos == std::string::npos ? 0 : source.find('\n', pos) + 1;
+    return source.substr(0, pos) + lines + source.substr(pos);
+}
+
 }
 
 shader_program::shader_program()
@@ -40,11 +99,16 @@ shader_program::shader_program()
 }
 
 void shader_program::add_shader(GLenum type, const char *path)
+{
+    add_shader(type, path, {});
+}
+
+void shader_program::add_shader(GLenum type, const char *path, const std::vector<std::string> &defines)
 {
     const auto shader_id = glCreateShader(type);
 
-    const auto source = load_file(path);
-    const auto source_ptr = source.data();
+    const auto source = insert_defines(load_source(path), defines);
+    const auto source_ptr = source.c_str();
     glShaderSource(shader_id, 1, &source_ptr, nullptr);
     glCompileShader(shader_id);
 
@@ -135,4 +199,9 @@ void shader_program::set_uniform(int location, const glm::mat4 &value) const
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
+void shader_program::set_uniform(int location, const std::vector<glm::mat4> &value) const
+{
+    glUniformMatrix4fv(location, value.size(), GL_FALSE, reinterpret_cast<const float *>(value.data()));
+}
+
 }
@@ -5,8 +5,9 @@
 #include <GL/glew.h>
 
 #include <array>
-#include <vector>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include <glm/glm.hpp>
 
@@ -18,6 +19,9 @@ public:
     shader_program();
 
     void add_shader(GLenum type, const char *path);
+    // Each define ("NAME" or "NAME value") is inserted as a #define after the #version
+    // line, for build-time variants of the same source.
+    void add_shader(GLenum type, const char *path, const std::vector<std::string> &defines);
     void link();
 
     void bind() const;
@@ -37,6 +41,7 @@ public:
 
     void set_uniform(int location, const glm::mat3 &mat) const;
     void set_uniform(int location, const glm::mat4 &mat) const;
+    void set_uniform(int location, const std::vector<glm::mat4> &v) const;
 
     template<typename T>
     void set_uniform(std::string_view name, const T &value) const
@@ -0,0 +1,12 @@
+#version 450 core
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+
+void main()
+{
+    frag_color = texture(image, tex_coords);
+}
@@ -0,0 +1,29 @@
+#version 450 core
+
+// One direction of one blur_effect pass. The taps come from gaussian_kernel.h as
+// constants, each one a bilinear fetch standing for two texels.
+
+out vec4 frag_color;
+  
+in vec2 tex_coords;
+
+uniform sampler2D image;
+uniform bool horizontal;
+
+const float offsets[BLUR_TAP_COUNT] = float[](BLUR_OFFSETS);
+const float weights[BLUR_TAP_COUNT] = float[](BLUR_WEIGHTS);
+
+void main()
+{             
+    vec2 texelSize = 1.0 / textureSize(image, 0);
+    vec2 direction = horizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+
+    vec4 result = textureLod(image, tex_coords, 0.0) * weights[0];
+    for (int i = 1; i < BLUR_TAP_COUNT; ++i) {
+        result += textureLod(image, tex_coords + offsets[i] * direction, 0.0) * weights[i];
+        result += textureLod(image, tex_coords - offsets[i] * direction, 0.0) * weights[i];
+    }
+
+    // all four channels, shadow_buffer keeps moments in them
+    frag_color = result;
+}
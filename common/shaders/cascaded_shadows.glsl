@@ -0,0 +1,37 @@
+// Cascade selection and lookup for gl::cascaded_shadow_map. Fragment shaders only: the
+// view depth is recovered from gl_FragCoord.w, which assumes a perspective projection.
+// The filter is shadow_sampling.glsl's, configured through its defines.
+
+#include "shadow_sampling.glsl"
+
+const int MaxCascades = 4;
+
+uniform sampler2DArrayShadow cascadeShadowTexture;
+uniform mat4 cascadeViewProjection[MaxCascades];
+uniform float cascadeSplits[MaxCascades];
+uniform int cascadeCount;
+
+int shadowCascade(float viewDepth)
+{
+    for (int i = 0; i < cascadeCount - 1; ++i)
+    {
+        if (viewDepth < cascadeSplits[i])
+            return i;
+    }
+    return cascadeCount - 1;
+}
+
+// fraction of the light reaching worldPosition
+float cascadedShadow(vec3 worldPosition)
+{
+    float viewDepth = 1.0 / gl_FragCoord.w;
+    if (viewDepth > cascadeSplits[cascadeCount - 1])
+        return 1.0;
+
+    int cascade = shadowCascade(viewDepth);
+
+    vec4 positionInLightSpace = cascadeViewProjection[cascade] * vec4(worldPosition, 1.0);
+    vec3 projCoords = 0.5 * positionInLightSpace.xyz / positionInLightSpace.w + 0.5;
+
+    return shadowFactor(cascadeShadowTexture, projCoords, float(cascade));
+}
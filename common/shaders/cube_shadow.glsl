@@ -0,0 +1,32 @@
+// Point light shadows from gl::cube_shadow_buffer. Uniforms are set by
+// cube_shadow_buffer::set_uniforms().
+
+uniform vec3 cubeShadowLightPosition;
+uniform float cubeShadowFar;
+uniform mat4 cubeShadowFaceMatrices[6];
+
+// Face drawn by a caster instance: the instance-th set bit of the draw's face mask
+// (cube_shadow_buffer::face_mask), so that culled faces cost no instance.
+int cubeShadowFace(uint faceMask, int instance)
+{
+    for (int face = 0; face < 6; ++face)
+    {
+        if ((faceMask & (1u << face)) != 0u && instance-- == 0)
+            return face;
+    }
+    return 0;
+}
+
+// what casters write to gl_FragDepth
+float cubeShadowDepth(vec3 worldPosition)
+{
+    return length(worldPosition - cubeShadowLightPosition) / cubeShadowFar;
+}
+
+// Fraction of the light reaching worldPosition. The bias is in world units; polygon
+// offset doesn't apply to depth written by the fragment shader.
+float cubeShadowFactor(samplerCubeShadow shadowMap, vec3 worldPosition, float bias)
+{
+    vec3 direction = worldPosition - cubeShadowLightPosition;
+    return texture(shadowMap, vec4(direction, (length(direction) - bias) / cubeShadowFar));
+}
@@ -0,0 +1,7 @@
+#version 450 core
+
+// depth_prepass's fragment shader for materials that don't discard
+
+void main()
+{
+}
@@ -0,0 +1,40 @@
+#version 450 core
+
+// Dual filter down and upsampling for blur_effect::render_glow(). Downsampling
+// averages the texel with its four diagonal neighbours, upsampling is an 8 tap tent;
+// both lean on bilinear filtering for the taps in between.
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+uniform bool downsample;
+uniform float spread; // tap distance in half texels of the source
+
+void main()
+{
+    vec2 offset = spread * 0.5 / vec2(textureSize(image, 0));
+
+    if (downsample)
+    {
+        vec4 sum = 4.0 * texture(image, tex_coords);
+        sum += texture(image, tex_coords - offset);
+        sum += texture(image, tex_coords + offset);
+        sum += texture(image, tex_coords + vec2(offset.x, -offset.y));
+        sum += texture(image, tex_coords + vec2(-offset.x, offset.y));
+        frag_color = sum / 8.0;
+    }
+    else
+    {
+        vec4 sum = texture(image, tex_coords + vec2(-2.0 * offset.x, 0.0));
+        sum += texture(image, tex_coords + vec2(2.0 * offset.x, 0.0));
+        sum += texture(image, tex_coords + vec2(0.0, -2.0 * offset.y));
+        sum += texture(image, tex_coords + vec2(0.0, 2.0 * offset.y));
+        sum += 2.0 * texture(image, tex_coords + vec2(-offset.x, offset.y));
+        sum += 2.0 * texture(image, tex_coords + vec2(offset.x, offset.y));
+        sum += 2.0 * texture(image, tex_coords + vec2(-offset.x, -offset.y));
+        sum += 2.0 * texture(image, tex_coords + vec2(offset.x, -offset.y));
+        frag_color = sum / 12.0;
+    }
+}
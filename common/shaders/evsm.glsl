@@ -0,0 +1,43 @@
+// Exponential variance shadow maps (see gl::shadow_buffer). Casters write
+// evsmMoments(gl_FragCoord.z), receivers call evsmShadow() with their light space
+// position after the perspective divide, mapped to [0, 1].
+
+uniform vec2 evsmExponents;
+uniform float evsmLightBleedingReduction;
+uniform float evsmVarianceBias;
+
+vec2 evsmWarpDepth(float depth)
+{
+    depth = 2.0 * depth - 1.0;
+    return vec2(exp(evsmExponents.x * depth), -exp(-evsmExponents.y * depth));
+}
+
+vec4 evsmMoments(float depth)
+{
+    vec2 warped = evsmWarpDepth(depth);
+    return vec4(warped.x, warped.x * warped.x, warped.y, warped.y * warped.y);
+}
+
+float evsmChebyshev(vec2 moments, float mean, float minVariance)
+{
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    // cut off the tail of the bound, that's where the light bleeding is
+    pMax = clamp((pMax - evsmLightBleedingReduction) / (1.0 - evsmLightBleedingReduction), 0.0, 1.0);
+    return mean <= moments.x ? 1.0 : pMax;
+}
+
+float evsmShadow(sampler2D momentsTexture, vec3 projCoords)
+{
+    vec2 warped = evsmWarpDepth(projCoords.z);
+
+    // one trilinear tap, the blur and mip chain do the filtering
+    vec4 moments = texture(momentsTexture, projCoords.xy);
+
+    // the bias is in depth units, scale it by the slope of the warp
+    vec2 depthScale = evsmVarianceBias * evsmExponents * warped;
+    vec2 minVariance = depthScale * depthScale;
+
+    return min(evsmChebyshev(moments.xy, warped.x, minVariance.x), evsmChebyshev(moments.zw, warped.y, minVariance.y));
+}
@@ -0,0 +1,58 @@
+#version 450 core
+
+// FXAA (Lottes, "FXAA", NVIDIA 2009), the cheap variant: four diagonal luma samples
+// find the edge direction, then two or four taps along it blur across the edge. Pixels
+// without enough local contrast are passed through.
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+
+const float EdgeThreshold = 1.0 / 8.0;
+const float EdgeThresholdMin = 1.0 / 32.0;
+const float ReduceMin = 1.0 / 128.0;
+const float ReduceMul = 1.0 / 8.0;
+const float SpanMax = 8.0;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 sampleAt(vec2 offset)
+{
+    return textureLod(image, tex_coords + offset, 0.0).rgb;
+}
+
+void main()
+{
+    vec2 texelSize = 1.0 / textureSize(image, 0);
+
+    vec3 colorM = sampleAt(vec2(0.0));
+    float lumaM = luma(colorM);
+    float lumaNW = luma(sampleAt(vec2(-0.5, -0.5) * texelSize));
+    float lumaNE = luma(sampleAt(vec2(0.5, -0.5) * texelSize));
+    float lumaSW = luma(sampleAt(vec2(-0.5, 0.5) * texelSize));
+    float lumaSE = luma(sampleAt(vec2(0.5, 0.5) * texelSize));
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EdgeThresholdMin, lumaMax * EdgeThreshold)) {
+        frag_color = vec4(colorM, 1.0);
+        return;
+    }
+
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * ReduceMul, ReduceMin);
+    float inverseDirectionMin = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * inverseDirectionMin, vec2(-SpanMax), vec2(SpanMax)) * texelSize;
+
+    vec3 colorA = 0.5 * (sampleAt(direction * (1.0 / 3.0 - 0.5)) + sampleAt(direction * (2.0 / 3.0 - 0.5)));
+    vec3 colorB = colorA * 0.5 + 0.25 * (sampleAt(direction * -0.5) + sampleAt(direction * 0.5));
+
+    // the wider blur overshot, it crossed into something else
+    float lumaB = luma(colorB);
+    frag_color = vec4((lumaB < lumaMin || lumaB > lumaMax) ? colorA : colorB, 1.0);
+}
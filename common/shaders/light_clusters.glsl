@@ -0,0 +1,71 @@
+// Clustered point lights, see gl::light_clusters. The grid comes from
+// light_clusters::shader_defines(): CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z and
+// MAX_CLUSTER_LIGHTS.
+
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 color;
+};
+
+// bindings as in light_clusters.h
+layout (std430, binding=1) buffer PointLights
+{
+    PointLight pointLights[];
+};
+
+layout (std430, binding=2) buffer ClusterCounts
+{
+    uint clusterCounts[];
+};
+
+layout (std430, binding=3) buffer ClusterIndices
+{
+    uint clusterIndices[];
+};
+
+const int ClusterCount = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+uniform vec2 clusterDepthRange; // view space depth covered by the slices
+
+// view space depth where a slice starts; the slices are exponentially spaced so that
+// clusters stay roughly cube shaped
+float clusterSliceDepth(int slice)
+{
+    return clusterDepthRange.x * pow(clusterDepthRange.y / clusterDepthRange.x, float(slice) / float(CLUSTER_GRID_Z));
+}
+
+int clusterSlice(float viewDepth)
+{
+    float slice = log(viewDepth / clusterDepthRange.x) / log(clusterDepthRange.y / clusterDepthRange.x);
+    return clamp(int(floor(slice * float(CLUSTER_GRID_Z))), 0, CLUSTER_GRID_Z - 1);
+}
+
+uniform vec2 clusterViewport; // in pixels
+
+// cluster of a fragment, from gl_FragCoord and its (positive) view space depth
+int clusterIndex(vec2 fragCoord, float viewDepth)
+{
+    ivec2 tile = ivec2(fragCoord / clusterViewport * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y));
+    tile = clamp(tile, ivec2(0), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    return (clusterSlice(viewDepth) * CLUSTER_GRID_Y + tile.y) * CLUSTER_GRID_X + tile.x;
+}
+
+uint clusterLightCount(int cluster)
+{
+    return clusterCounts[cluster];
+}
+
+PointLight clusterLight(int cluster, uint i)
+{
+    return pointLights[clusterIndices[cluster * MAX_CLUSTER_LIGHTS + int(i)]];
+}
+
+// smooth falloff reaching zero at the light's radius, so that culling by the radius
+// doesn't show
+float pointLightAttenuation(PointLight light, vec3 position)
+{
+    float d = length(light.positionRadius.xyz - position) / light.positionRadius.w;
+    float window = clamp(1.0 - d * d * d * d, 0.0, 1.0);
+    return window * window / (1.0 + 25.0 * d * d);
+}
@@ -0,0 +1,25 @@
+#version 450 core
+
+// weighted_oit's resolve, blended over the screen with GL_SRC_ALPHA/GL_ONE_MINUS_SRC_ALPHA:
+// the weighted average color covers 1 - revealage of what was there.
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+void main()
+{
+    float revealed = textureLod(revealage, tex_coords, 0.0).r;
+    if (revealed == 1.0)
+        discard;
+
+    vec4 accumulated = textureLod(accumulation, tex_coords, 0.0);
+    // a few overlapping fragments with large weights can overflow half floats
+    if (isinf(accumulated.a))
+        accumulated.a = max(max(accumulated.r, accumulated.g), accumulated.b);
+
+    frag_color = vec4(accumulated.rgb / max(accumulated.a, 1e-5), 1.0 - revealed);
+}
@@ -0,0 +1,171 @@
+// Filtered lookups into comparison shadow maps (gl::shadow_buffer, multi_shadow_buffer).
+// The filter is chosen when the program is built, through add_shader() defines:
+//
+//   SHADOW_PCF_SIZE 3, 5 or 7   footprint in texels of the PCF kernel (default 5)
+//   SHADOW_POISSON              rotated Poisson disk instead of PCF
+//   SHADOW_POISSON_RADIUS r     its radius in texels (default 3)
+//
+// shadowFactor() returns the fraction of the light reaching projCoords, the light space
+// position after the perspective divide mapped to [0, 1].
+
+#ifndef SHADOW_PCF_SIZE
+#define SHADOW_PCF_SIZE 5
+#endif
+
+#ifndef SHADOW_POISSON_RADIUS
+#define SHADOW_POISSON_RADIUS 3.0
+#endif
+
+// The PCF kernels are Castaño's bilinear-weighted ones ("Shadow Mapping Summary", 2013),
+// expressed per texel so that they can be applied to textureGather results: every
+// gather does four comparisons, so the 3x3, 5x5 and 7x7 kernels take 4, 9 and 16
+// fetches. s is the offset of the lookup into its texel; the kernel covers
+// SHADOW_PCF_SIZE + 1 texels along each axis.
+
+const int ShadowKernelTexels = SHADOW_PCF_SIZE + 1;
+
+void shadowKernelWeights(float s, out float w[ShadowKernelTexels])
+{
+#if SHADOW_PCF_SIZE == 3
+    w = float[](1.0 - s, 2.0 - s, 1.0 + s, s);
+#elif SHADOW_PCF_SIZE == 5
+    w = float[](1.0 - s, 3.0 - 2.0 * s, 4.0 - s, 3.0 + s, 1.0 + 2.0 * s, s);
+#elif SHADOW_PCF_SIZE == 7
+    w = float[](1.0 - s, 5.0 - 4.0 * s, 12.0 - 7.0 * s, 16.0 - 4.0 * s, 12.0 + 4.0 * s, 5.0 + 7.0 * s, 1.0 + 4.0 * s, s);
+#else
+#error SHADOW_PCF_SIZE must be 3, 5 or 7
+#endif
+}
+
+#if SHADOW_PCF_SIZE == 3
+const float ShadowKernelWeight = 16.0;
+#elif SHADOW_PCF_SIZE == 5
+const float ShadowKernelWeight = 144.0;
+#else
+const float ShadowKernelWeight = 2704.0;
+#endif
+
+// Texel corner closest to uv, in texels, and where uv falls relative to it.
+void shadowKernelOrigin(vec2 uv, vec2 size, out vec2 corner, out vec2 s)
+{
+    vec2 texel = uv * size;
+    corner = floor(texel + 0.5);
+    s = texel + 0.5 - corner;
+}
+
+// Combines the four comparisons of a gather (see the textureGather component order)
+// with the weights of texels (i, j) to (i + 1, j + 1).
+float shadowWeightGather(vec4 g, float wx[ShadowKernelTexels], float wy[ShadowKernelTexels], int i, int j)
+{
+    return g.w * wx[i] * wy[j] + g.z * wx[i + 1] * wy[j] + g.x * wx[i] * wy[j + 1] + g.y * wx[i + 1] * wy[j + 1];
+}
+
+float shadowGatherPCF(sampler2DShadow shadowMap, vec3 projCoords)
+{
+    vec2 size = vec2(textureSize(shadowMap, 0));
+    vec2 corner, s;
+    shadowKernelOrigin(projCoords.xy, size, corner, s);
+
+    float wx[ShadowKernelTexels], wy[ShadowKernelTexels];
+    shadowKernelWeights(s.x, wx);
+    shadowKernelWeights(s.y, wy);
+
+    const int radius = SHADOW_PCF_SIZE / 2;
+
+    float sum = 0.0;
+    for (int j = 0; j < SHADOW_PCF_SIZE; j += 2)
+    {
+        for (int i = 0; i < SHADOW_PCF_SIZE; i += 2)
+        {
+            // gathering at a texel corner fetches the 2x2 texels around it
+            vec2 uv = (corner + vec2(i - radius, j - radius)) / size;
+            sum += shadowWeightGather(textureGather(shadowMap, uv, projCoords.z), wx, wy, i, j);
+        }
+    }
+    return sum / ShadowKernelWeight;
+}
+
+float shadowGatherPCF(sampler2DArrayShadow shadowMap, vec3 projCoords, float layer)
+{
+    vec2 size = vec2(textureSize(shadowMap, 0).xy);
+    vec2 corner, s;
+    shadowKernelOrigin(projCoords.xy, size, corner, s);
+
+    float wx[ShadowKernelTexels], wy[ShadowKernelTexels];
+    shadowKernelWeights(s.x, wx);
+    shadowKernelWeights(s.y, wy);
+
+    const int radius = SHADOW_PCF_SIZE / 2;
+
+    float sum = 0.0;
+    for (int j = 0; j < SHADOW_PCF_SIZE; j += 2)
+    {
+        for (int i = 0; i < SHADOW_PCF_SIZE; i += 2)
+        {
+            vec2 uv = (corner + vec2(i - radius, j - radius)) / size;
+            sum += shadowWeightGather(textureGather(shadowMap, vec3(uv, layer), projCoords.z), wx, wy, i, j);
+        }
+    }
+    return sum / ShadowKernelWeight;
+}
+
+// 16 tap Poisson disk, rotated per pixel with interleaved gradient noise (Jimenez,
+// "Next Generation Post Processing in Call of Duty: Advanced Warfare") so that the
+// banding turns into noise. Every tap is a bilinear PCF lookup.
+
+const vec2 ShadowPoissonDisk[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+    vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420),
+    vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590),
+    vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790));
+
+mat2 shadowPoissonRotation()
+{
+    float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float angle = 6.28318531 * noise;
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat2(c, s, -s, c);
+}
+
+float shadowPoisson(sampler2DShadow shadowMap, vec3 projCoords)
+{
+    mat2 rotation = shadowPoissonRotation() * (SHADOW_POISSON_RADIUS / vec2(textureSize(shadowMap, 0)).x);
+
+    float sum = 0.0;
+    for (int i = 0; i < 16; ++i)
+        sum += texture(shadowMap, vec3(projCoords.xy + rotation * ShadowPoissonDisk[i], projCoords.z));
+    return sum / 16.0;
+}
+
+float shadowPoisson(sampler2DArrayShadow shadowMap, vec3 projCoords, float layer)
+{
+    mat2 rotation = shadowPoissonRotation() * (SHADOW_POISSON_RADIUS / vec2(textureSize(shadowMap, 0).xy).x);
+
+    float sum = 0.0;
+    for (int i = 0; i < 16; ++i)
+        sum += texture(shadowMap, vec4(projCoords.xy + rotation * ShadowPoissonDisk[i], layer, projCoords.z));
+    return sum / 16.0;
+}
+
+float shadowFactor(sampler2DShadow shadowMap, vec3 projCoords)
+{
+#ifdef SHADOW_POISSON
+    return shadowPoisson(shadowMap, projCoords);
+#else
+    return shadowGatherPCF(shadowMap, projCoords);
+#endif
+}
+
+float shadowFactor(sampler2DArrayShadow shadowMap, vec3 projCoords, float layer)
+{
+#ifdef SHADOW_POISSON
+    return shadowPoisson(shadowMap, projCoords, layer);
+#else
+    return shadowGatherPCF(shadowMap, projCoords, layer);
+#endif
+}
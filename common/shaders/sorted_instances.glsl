@@ -0,0 +1,11 @@
+// The instance order written by instance_sort, see instance_sort.h
+
+layout(std430, binding=4) readonly buffer SortedInstances
+{
+    uint sortedInstances[];
+};
+
+int sortedInstance(int instance)
+{
+    return int(sortedInstances[instance]);
+}
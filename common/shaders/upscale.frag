@@ -0,0 +1,45 @@
+#version 450 core
+
+// dynamic_resolution's edge aware upscale: bilinear, except where the 2x2 texels around
+// the sample have a strong luma gradient. There the result is averaged along the edge,
+// perpendicular to the gradient, which smooths the magnified stair steps without
+// blurring across the edge.
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+
+const float EdgeThreshold = 0.05;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 size = vec2(textureSize(image, 0));
+    vec2 texelSize = 1.0 / size;
+
+    // the texels bilinear filtering blends here
+    vec2 corner = (floor(tex_coords * size - 0.5) + 0.5) * texelSize;
+    float lumaA = luma(texture(image, corner).rgb);
+    float lumaB = luma(texture(image, corner + vec2(texelSize.x, 0.0)).rgb);
+    float lumaC = luma(texture(image, corner + vec2(0.0, texelSize.y)).rgb);
+    float lumaD = luma(texture(image, corner + texelSize).rgb);
+
+    vec4 bilinear = texture(image, tex_coords);
+
+    vec2 gradient = vec2((lumaB + lumaD) - (lumaA + lumaC), (lumaC + lumaD) - (lumaA + lumaB));
+    float strength = length(gradient);
+    if (strength < EdgeThreshold) {
+        frag_color = bilinear;
+        return;
+    }
+
+    vec2 along = vec2(-gradient.y, gradient.x) / strength * texelSize;
+    vec4 edge = 0.5 * (texture(image, tex_coords + 0.5 * along) + texture(image, tex_coords - 0.5 * along));
+    frag_color = mix(bilinear, edge, smoothstep(EdgeThreshold, 4.0 * EdgeThreshold, strength));
+}
@@ -0,0 +1,30 @@
+// Output of translucent fragment shaders, see weighted_oit.h. With WEIGHTED_OIT defined
+// writeTranslucent() goes to the accumulation and revealage targets, otherwise it's an
+// ordinary color to blend over what was drawn before.
+
+#ifdef WEIGHTED_OIT
+layout(location=0) out vec4 oit_accumulation;
+layout(location=1) out float oit_revealage;
+#else
+layout(location=0) out vec4 frag_color;
+#endif
+
+// Weight by window space depth, equation 9 of the paper. It doesn't depend on the
+// scene's units, so it holds up for the small view distances of the demos.
+float oitWeight(float alpha)
+{
+    float z = 1.0 - gl_FragCoord.z;
+    return alpha * clamp(3e3 * z * z * z, 1e-2, 3e3);
+}
+
+// color isn't premultiplied
+void writeTranslucent(vec4 color)
+{
+#ifdef WEIGHTED_OIT
+    float weight = oitWeight(color.a);
+    oit_accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    oit_revealage = color.a;
+#else
+    frag_color = color;
+#endif
+}
@@ -0,0 +1,106 @@
+#include "shadow_atlas.h"
+
+#include "panic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace gl {
+
+namespace {
+
+bool is_power_of_two(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// every other bit of a Morton index
+int compact_bits(int n)
+{
+    int result = 0;
+    for (int bit = 0; n >> (2 * bit); ++bit)
+        result |= ((n >> (2 * bit)) & 1) << bit;
+    return result;
+}
+
+} // namespace
+
+shadow_atlas::shadow_atlas(const shadow_buffer_desc &desc, int min_tile_size)
+    : min_tile_size_(min_tile_size)
+    , buffer_(desc)
+{
+    if (desc.width != desc.height || !is_power_of_two(desc.width))
+        panic("shadow atlas must be a power of two square, not %dx%d\n", desc.width, desc.height);
+    if (!is_power_of_two(min_tile_size) || min_tile_size > max_tile_size())
+        panic("invalid shadow atlas tile size %d\n", min_tile_size);
+    if (desc.filter != shadow_filter::pcf)
+        panic("shadow atlas tiles can't be filtered independently\n");
+}
+
+int shadow_atlas::tile_size(float ideal_size, int current_size) const
+{
+    constexpr auto Hysteresis = 0.25f; // in powers of two, on top of the halfway point
+
+    const auto ideal = std::log2(std::max(ideal_size, 1.0f));
+    auto level = std::round(ideal);
+    if (current_size > 0) {
+        const auto current = std::log2(static_cast<float>(current_size));
+        if (std::abs(ideal - current) < 0.5f + Hysteresis)
+            level = current;
+    }
+
+    const auto size = static_cast<int>(std::exp2(level));
+    return std::clamp(size, min_tile_size_, max_tile_size());
+}
+
+bool shadow_atlas::pack(const std::vector<int> &sizes)
+{
+    std::vector<int> fitted(sizes.size());
+    std::transform(sizes.begin(), sizes.end(), fitted.begin(),
+                   [this](int size) { return std::clamp(size, min_tile_size_, max_tile_size()); });
+
+    // areas in units of the smallest tile
+    const auto units = [this](int size) { return (size / min_tile_size_) * (size / min_tile_size_); };
+    const auto capacity = units(size());
+
+    auto total = std::accumulate(fitted.begin(), fitted.end(), 0,
+                                 [&units](int sum, int size) { return sum + units(size); });
+    while (total > capacity) {
+        auto largest = std::max_element(fitted.begin(), fitted.end());
+        if (*largest == min_tile_size_)
+            panic("%d shadow tiles don't fit in a %d atlas\n", static_cast<int>(sizes.size()), size());
+        total -= units(*largest) - units(*largest / 2);
+        *largest /= 2;
+    }
+
+    std::vector<int> order(fitted.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&fitted](int a, int b) { return fitted[a] > fitted[b]; });
+
+    // Sizes only go down, so the cursor is always aligned to the tile being placed and
+    // the Morton index of the cursor is its corner.
+    std::vector<atlas_tile> tiles(fitted.size());
+    int cursor = 0;
+    for (auto index : order) {
+        tiles[index] = { compact_bits(cursor) * min_tile_size_, compact_bits(cursor >> 1) * min_tile_size_,
+                         fitted[index] };
+        cursor += units(fitted[index]);
+    }
+
+    const auto changed = tiles.size() != tiles_.size() ||
+                         !std::equal(tiles.begin(), tiles.end(), tiles_.begin(), [](const auto &a, const auto &b) {
+                             return a.x == b.x && a.y == b.y && a.size == b.size;
+                         });
+    tiles_ = std::move(tiles);
+    return changed;
+}
+
+glm::vec4 shadow_atlas::uv_rect(int index) const
+{
+    const auto &tile = tiles_[index];
+    const auto scale = 1.0f / size();
+    return glm::vec4(tile.x * scale, tile.y * scale, tile.size * scale, tile.size * scale);
+}
+
+} // namespace gl
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "shadow_buffer.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gl {
+
+struct atlas_tile
+{
+    int x = 0;
+    int y = 0;
+    int size = 0;
+};
+
+// Square shadow tiles of many lights packed into a single depth texture. Tile sizes
+// are powers of two; packing them largest first in Morton order is a quadtree
+// allocation without holes, so everything fits as long as the total area does.
+class shadow_atlas : private noncopyable
+{
+public:
+    // desc must be square with a power of two size; tiles range from min_tile_size to
+    // half the atlas
+    explicit shadow_atlas(const shadow_buffer_desc &desc, int min_tile_size = 64);
+
+    int size() const { return buffer_.width(); }
+    int min_tile_size() const { return min_tile_size_; }
+    int max_tile_size() const { return buffer_.width() / 2; }
+
+    // Power of two tile size for a light that would ideally get ideal_size texels. The
+    // size only moves away from current_size once the ideal is well past the halfway
+    // point to the next step, so lights near a boundary don't flip every frame. Pass 0
+    // as current_size for a new light.
+    int tile_size(float ideal_size, int current_size) const;
+
+    // Places tiles of the requested sizes, halving the largest ones until they fit.
+    // Returns whether any tile moved or changed size since the previous call.
+    bool pack(const std::vector<int> &sizes);
+
+    int tile_count() const { return tiles_.size(); }
+    const atlas_tile &tile(int index) const { return tiles_[index]; }
+
+    // uv offset in xy and scale in zw, maps [0, 1] light space to the tile
+    glm::vec4 uv_rect(int index) const;
+
+    const shadow_buffer &buffer() const { return buffer_; }
+
+private:
+    int min_tile_size_;
+    shadow_buffer buffer_;
+    std::vector<atlas_tile> tiles_;
+};
+
+} // namespace gl
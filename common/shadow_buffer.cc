@@ -1,32 +1,42 @@
 #include "shadow_buffer.h"
 
+#include "caps.h"
+#include "framebuffer.h"
+#include "blur_effect.h"
+#include "shader_program.h"
+
+#include <algorithm>
+#include <cmath>
+
 namespace gl {
 
-shadow_buffer::shadow_buffer(int width, int height)
-    : width_{ width }
-    , height_{ height }
+shadow_buffer::shadow_buffer(int width, int height, shadow_filter filter)
+    : shadow_buffer(make_desc(width, height, filter))
 {
-    glGenTextures(1, &texture_id_);
-    glGenFramebuffers(1, &fbo_id_);
-    // glGenRenderbuffers(1, &rbo_id_);
+}
 
-    // initialize texture
+shadow_buffer::shadow_buffer(const shadow_buffer_desc &desc)
+    : desc_{ desc }
+{
+    if (desc_.filter == shadow_filter::evsm) {
+        // 32-bit moments, 16 bits can't hold the exponential warp; the depth format
+        // doesn't apply, casters are depth tested against the blur framebuffer's buffer
+        const auto levels = static_cast<int>(std::log2(std::max(desc_.width, desc_.height))) + 1;
+        moments_.reset(new blur_effect(desc_.width, desc_.height, GL_RGBA32F, levels));
+        return;
+    }
 
-    // note to self: non-power of 2 textures are allowed on es >2.0 if
-    // GL_MIN_FILTER is set to a function that doesn't require mipmaps
-    // and texture wrap is set to GL_CLAMP_TO_EDGE
+    texture_id_ = detail::create_depth_texture(GL_TEXTURE_2D, desc_);
 
-    bind_texture();
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width_, height_, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    unbind_texture();
+    if (caps().direct_state_access) {
+        glCreateFramebuffers(1, &fbo_id_);
+        glNamedFramebufferTexture(fbo_id_, GL_DEPTH_ATTACHMENT, texture_id_, 0);
+        glNamedFramebufferDrawBuffer(fbo_id_, GL_NONE);
+        glNamedFramebufferReadBuffer(fbo_id_, GL_NONE);
+        return;
+    }
 
-    // initialize shadow_buffer/renderbuffer
+    glGenFramebuffers(1, &fbo_id_);
 
     bind();
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture_id_, 0);
@@ -35,6 +45,15 @@ shadow_buffer::shadow_buffer(int width, int height)
     unbind();
 }
 
+shadow_buffer_desc shadow_buffer::make_desc(int width, int height, shadow_filter filter)
+{
+    shadow_buffer_desc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.filter = filter;
+    return desc;
+}
+
 shadow_buffer::~shadow_buffer()
 {
     glDeleteFramebuffers(1, &fbo_id_);
@@ -43,17 +62,41 @@ shadow_buffer::~shadow_buffer()
 
 void shadow_buffer::bind() const
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_);
+    if (desc_.filter == shadow_filter::evsm)
+        moments_->bind();
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_);
 }
 
 void shadow_buffer::unbind() const
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebuffer::unbind();
+}
+
+void shadow_buffer::clear() const
+{
+    if (desc_.filter == shadow_filter::evsm) {
+        // moments of the warped far plane, see evsmMoments() in evsm.glsl
+        const auto positive = std::exp(evsm_.exponents.x);
+        const auto negative = -std::exp(-evsm_.exponents.y);
+        const GLfloat moments[] = { positive, positive * positive, negative, negative * negative };
+        glClearBufferfv(GL_COLOR, 0, moments);
+    }
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void shadow_buffer::prefilter() const
+{
+    if (desc_.filter == shadow_filter::evsm)
+        moments_->blur(evsm_.blur_passes);
 }
 
 void shadow_buffer::bind_texture() const
 {
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    if (desc_.filter == shadow_filter::evsm)
+        moments_->bind_texture();
+    else
+        glBindTexture(GL_TEXTURE_2D, texture_id_);
 }
 
 void shadow_buffer::unbind_texture() const
@@ -61,4 +104,11 @@ void shadow_buffer::unbind_texture() const
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void shadow_buffer::set_uniforms(const shader_program &program) const
+{
+    program.set_uniform("evsmExponents", evsm_.exponents);
+    program.set_uniform("evsmLightBleedingReduction", evsm_.light_bleeding_reduction);
+    program.set_uniform("evsmVarianceBias", evsm_.variance_bias);
+}
+
 } // namespace gl
@@ -1,31 +1,70 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "shadow_buffer_desc.h"
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <memory>
 
 namespace gl {
 
+class blur_effect;
+class shader_program;
+
+struct evsm_settings
+{
+    // positive and negative warp; above ~42 the squared moments overflow 32-bit floats
+    glm::vec2 exponents = glm::vec2(40.0f, 5.0f);
+    // fraction of the Chebyshev bound treated as fully shadowed, trades softness for
+    // less light bleeding where occluders overlap
+    float light_bleeding_reduction = 0.3f;
+    // minimum variance in depth units, against acne on lit surfaces
+    float variance_bias = 0.0001f;
+    int blur_passes = 1;
+};
+
 class shadow_buffer : private noncopyable
 {
 public:
-    shadow_buffer(int width, int height);
+    explicit shadow_buffer(const shadow_buffer_desc &desc);
+    shadow_buffer(int width, int height, shadow_filter filter = shadow_filter::pcf);
     ~shadow_buffer();
 
     void bind() const;
     void unbind() const;
 
+    // clears to the far plane, in whatever form the filter stores it; assumes the buffer is bound
+    void clear() const;
+
+    // EVSM: blurs the moments and rebuilds their mip chain once the casters are drawn.
+    // Nothing to do for PCF.
+    void prefilter() const;
+
     void bind_texture() const;
     void unbind_texture() const;
 
-    int width() const { return width_; }
-    int height() const { return height_; }
+    int width() const { return desc_.width; }
+    int height() const { return desc_.height; }
+    shadow_filter filter() const { return desc_.filter; }
+    const shadow_buffer_desc &desc() const { return desc_; }
+    GLuint texture_handle() const { return texture_id_; } // the depth texture, PCF only
+
+    evsm_settings &evsm() { return evsm_; }
+    const evsm_settings &evsm() const { return evsm_; }
+
+    // evsm.glsl uniforms, for both the caster and the receiver programs
+    void set_uniforms(const shader_program &program) const;
 
 private:
-    int width_;
-    int height_;
-    GLuint texture_id_;
-    GLuint fbo_id_;
+    static shadow_buffer_desc make_desc(int width, int height, shadow_filter filter);
+
+    shadow_buffer_desc desc_;
+    evsm_settings evsm_;
+    GLuint texture_id_ = 0;
+    GLuint fbo_id_ = 0;
+    std::unique_ptr<blur_effect> moments_; // EVSM only, its framebuffer has the depth buffer for the casters
 };
 
 } // namespace gl
@@ -0,0 +1,100 @@
+#include "shadow_buffer_desc.h"
+
+#include "caps.h"
+#include "panic.h"
+
+#include <unistd.h>
+#include <cstdlib>
+
+namespace gl {
+
+GLenum shadow_depth_format(int bits)
+{
+    switch (bits) {
+    case 16:
+        return GL_DEPTH_COMPONENT16;
+    case 24:
+        return GL_DEPTH_COMPONENT24;
+    case 32:
+        return GL_DEPTH_COMPONENT32F;
+    default:
+        panic("unsupported shadow map depth bits %d\n", bits);
+        return GL_NONE;
+    }
+}
+
+shadow_buffer_desc parse_shadow_arguments(int argc, char *argv[], int default_size)
+{
+    auto desc = shadow_buffer_desc::square(default_size);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:z:")) != -1) {
+        switch (opt)
+        {
+        case 's':
+            desc.width = desc.height = std::atoi(optarg);
+            break;
+        case 'z':
+            desc.depth_format = shadow_depth_format(std::atoi(optarg));
+            break;
+        }
+    }
+
+    return desc;
+}
+
+namespace detail {
+
+GLuint create_depth_texture(GLenum target, const shadow_buffer_desc &desc)
+{
+    switch (desc.depth_format) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+        break;
+    default:
+        panic("unsupported shadow map depth format 0x%x\n", desc.depth_format);
+    }
+
+    if (desc.width < 1 || desc.height < 1 || desc.layers < 1)
+        panic("invalid shadow map size %dx%dx%d\n", desc.width, desc.height, desc.layers);
+
+    const GLint compare_mode = desc.compare ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE;
+
+    GLuint id;
+
+    if (caps().direct_state_access) {
+        glCreateTextures(target, 1, &id);
+        glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(id, GL_TEXTURE_COMPARE_MODE, compare_mode);
+        glTextureParameteri(id, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glTextureStorage3D(id, 1, desc.depth_format, desc.width, desc.height, desc.layers);
+        else
+            glTextureStorage2D(id, 1, desc.depth_format, desc.width, desc.height);
+        return id;
+    }
+
+    glGenTextures(1, &id);
+    glBindTexture(target, id);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, compare_mode);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    if (target == GL_TEXTURE_2D_ARRAY)
+        glTexStorage3D(target, 1, desc.depth_format, desc.width, desc.height, desc.layers);
+    else
+        glTexStorage2D(target, 1, desc.depth_format, desc.width, desc.height);
+    glBindTexture(target, 0);
+
+    return id;
+}
+
+} // namespace detail
+
+} // namespace gl
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+
+namespace gl {
+
+enum class shadow_filter
+{
+    pcf,  // depth texture with hardware comparison, sampled through a sampler2DShadow
+    evsm, // exponential variance moments, blurred and mipmapped; see common/shaders/evsm.glsl
+};
+
+// How shadow_buffer, multi_shadow_buffer and cube_shadow_buffer allocate their depth
+// texture.
+struct shadow_buffer_desc
+{
+    int width = 1024;
+    int height = 1024;
+    int layers = 1; // multi_shadow_buffer only
+    // GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT24 or GL_DEPTH_COMPONENT32F
+    GLenum depth_format = GL_DEPTH_COMPONENT24;
+    // hardware comparison for sampler2DShadow/sampler2DArrayShadow lookups; without it
+    // the raw depth is read through a plain sampler
+    bool compare = true;
+    shadow_filter filter = shadow_filter::pcf; // shadow_buffer only
+
+    static shadow_buffer_desc square(int size, int layers = 1)
+    {
+        shadow_buffer_desc desc;
+        desc.width = desc.height = size;
+        desc.layers = layers;
+        return desc;
+    }
+};
+
+// GL_DEPTH_COMPONENT16, 24 or 32F for 16, 24 or 32 bits
+GLenum shadow_depth_format(int bits);
+
+// Shadow map options of the demos that run their own main loop: -s <size> for the
+// width and height, -z <16|24|32> for the depth bits. gl::demo takes the same ones.
+shadow_buffer_desc parse_shadow_arguments(int argc, char *argv[], int default_size);
+
+namespace detail {
+
+// Immutable (glTexStorage) depth texture for a GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY or
+// GL_TEXTURE_CUBE_MAP shadow map.
+GLuint create_depth_texture(GLenum target, const shadow_buffer_desc &desc);
+
+} // namespace detail
+
+} // namespace gl
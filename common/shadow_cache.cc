@@ -0,0 +1,188 @@
+#include "shadow_cache.h"
+
+#include "shadow_buffer.h"
+#include "multi_shadow_buffer.h"
+#include "caps.h"
+#include "framebuffer.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace gl {
+
+shadow_cache::shadow_cache(const shadow_buffer &target)
+    : bind_target_([&target](int) { target.bind(); })
+    , pass_count_(1)
+{
+    // the cached depth is copied, blurred moments can't be updated incrementally
+    assert(target.filter() == shadow_filter::pcf);
+    init(GL_TEXTURE_2D, target.texture_handle(), target.width(), target.height(), 1);
+}
+
+shadow_cache::shadow_cache(const multi_shadow_buffer &target, bool layered)
+    : pass_count_(layered ? 1 : target.layers())
+{
+    if (layered)
+        bind_target_ = [&target](int) { target.bind_layered(); };
+    else
+        bind_target_ = [&target](int layer) { target.bind(layer); };
+    init(GL_TEXTURE_2D_ARRAY, target.texture_handle(), target.width(), target.height(), target.layers());
+}
+
+shadow_cache::~shadow_cache()
+{
+    glDeleteFramebuffers(fbo_id_.size(), fbo_id_.data());
+    glDeleteTextures(1, &texture_id_);
+}
+
+void shadow_cache::init(GLenum texture_target, GLuint target_texture, int width, int height, int layers)
+{
+    texture_target_ = texture_target;
+    target_texture_ = target_texture;
+    width_ = width;
+    height_ = height;
+    layers_ = layers;
+
+    // glCopyImageSubData needs matching formats, so the cache takes the target's.
+    // glTexStorage only accepts sized ones; a target allocated with an unsized one gets
+    // the size drivers give it.
+    GLint internal_format;
+    glBindTexture(texture_target_, target_texture_);
+    glGetTexLevelParameteriv(texture_target_, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+    glBindTexture(texture_target_, 0);
+    if (internal_format == GL_DEPTH_COMPONENT)
+        internal_format = GL_DEPTH_COMPONENT24;
+    else if (internal_format == GL_DEPTH_STENCIL)
+        internal_format = GL_DEPTH24_STENCIL8;
+
+    const auto dsa = caps().direct_state_access;
+
+    if (dsa) {
+        glCreateTextures(texture_target_, 1, &texture_id_);
+    } else {
+        glGenTextures(1, &texture_id_);
+        glBindTexture(texture_target_, texture_id_);
+    }
+
+    if (texture_target_ == GL_TEXTURE_2D_ARRAY) {
+        if (dsa)
+            glTextureStorage3D(texture_id_, 1, internal_format, width_, height_, layers_);
+        else
+            glTexStorage3D(texture_target_, 1, internal_format, width_, height_, layers_);
+    } else {
+        if (dsa)
+            glTextureStorage2D(texture_id_, 1, internal_format, width_, height_);
+        else
+            glTexStorage2D(texture_target_, 1, internal_format, width_, height_);
+    }
+
+    if (!dsa)
+        glBindTexture(texture_target_, 0);
+
+    fbo_id_.resize(pass_count_);
+
+    const bool layered = texture_target_ == GL_TEXTURE_2D_ARRAY && pass_count_ == 1;
+
+    for (int i = 0; i < pass_count_; ++i) {
+        if (dsa) {
+            glCreateFramebuffers(1, &fbo_id_[i]);
+            if (texture_target_ == GL_TEXTURE_2D_ARRAY && !layered)
+                glNamedFramebufferTextureLayer(fbo_id_[i], GL_DEPTH_ATTACHMENT, texture_id_, 0, i);
+            else
+                glNamedFramebufferTexture(fbo_id_[i], GL_DEPTH_ATTACHMENT, texture_id_, 0);
+            glNamedFramebufferDrawBuffer(fbo_id_[i], GL_NONE);
+            glNamedFramebufferReadBuffer(fbo_id_[i], GL_NONE);
+        } else {
+            glGenFramebuffers(1, &fbo_id_[i]);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_[i]);
+            if (texture_target_ == GL_TEXTURE_2D_ARRAY && !layered)
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0, i);
+            else
+                glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id_, 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            framebuffer::unbind();
+        }
+    }
+}
+
+int shadow_cache::add_caster(draw_function draw, bool is_static)
+{
+    casters_.push_back({ std::move(draw), is_static });
+    if (is_static)
+        invalidate();
+    return casters_.size() - 1;
+}
+
+void shadow_cache::set_static(int caster, bool is_static)
+{
+    if (casters_[caster].is_static != is_static) {
+        casters_[caster].is_static = is_static;
+        invalidate();
+    }
+}
+
+bool shadow_cache::has_dynamic_casters() const
+{
+    return std::any_of(casters_.begin(), casters_.end(), [](const caster &c) { return !c.is_static; });
+}
+
+void shadow_cache::invalidate()
+{
+    valid_ = false;
+}
+
+bool shadow_cache::update(const std::function<void(int layer)> &begin_layer,
+                          const std::function<void(int layer)> &end_layer)
+{
+    if (!valid_) {
+        for (int i = 0; i < pass_count_; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_[i]);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            begin_layer(i);
+            draw_casters(true);
+            if (end_layer)
+                end_layer(i);
+        }
+        framebuffer::unbind();
+
+        valid_ = true;
+        target_stale_ = true;
+        stats::add("shadow cache rebuilds", 1);
+    }
+
+    const auto dynamic_casters = has_dynamic_casters();
+
+    if (!dynamic_casters && !target_stale_) {
+        stats::add("shadow passes skipped", 1);
+        return false;
+    }
+
+    glCopyImageSubData(texture_id_, texture_target_, 0, 0, 0, 0, target_texture_, texture_target_, 0, 0, 0, 0,
+                       width_, height_, layers_);
+    target_stale_ = false;
+
+    if (dynamic_casters) {
+        for (int i = 0; i < pass_count_; ++i) {
+            bind_target_(i);
+            begin_layer(i);
+            draw_casters(false);
+            if (end_layer)
+                end_layer(i);
+        }
+        framebuffer::unbind();
+    }
+
+    return true;
+}
+
+void shadow_cache::draw_casters(bool static_casters) const
+{
+    for (const auto &c : casters_) {
+        if (c.is_static == static_casters)
+            c.draw();
+    }
+}
+
+} // namespace gl
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <vector>
+
+namespace gl {
+
+class shadow_buffer;
+class multi_shadow_buffer;
+
+// Keeps the depth of static shadow casters in a texture of its own, re-rendered only
+// when invalidated. Every frame the cached depth is copied into the live shadow map
+// (glCopyImageSubData) and only dynamic casters are drawn on top of it; when there
+// are none and the cache didn't change, the shadow pass is skipped altogether.
+class shadow_cache : private noncopyable
+{
+public:
+    explicit shadow_cache(const shadow_buffer &target);
+    // One pass per layer, so that each can get its own light matrices, or a single pass
+    // into the layered framebuffer of target (see multi_shadow_buffer::bind_layered).
+    explicit shadow_cache(const multi_shadow_buffer &target, bool layered = false);
+    ~shadow_cache();
+
+    using draw_function = std::function<void()>;
+
+    // Returns an id for set_static(). Casters draw with whatever program and uniforms
+    // the begin_layer callback passed to update() set up.
+    int add_caster(draw_function draw, bool is_static);
+    void set_static(int caster, bool is_static);
+    bool has_dynamic_casters() const;
+
+    // e.g. when the light or a static caster moves
+    void invalidate();
+
+    // Brings the live shadow map up to date. begin_layer(layer) is called with that
+    // layer's framebuffer bound, before its casters are drawn (layer is always 0 for
+    // layered passes), and end_layer(layer) after them, e.g. to submit the draws the
+    // casters queued in a single batch. Returns false if nothing had to be done.
+    bool update(const std::function<void(int layer)> &begin_layer,
+                const std::function<void(int layer)> &end_layer = {});
+
+private:
+    void init(GLenum texture_target, GLuint target_texture, int width, int height, int layers);
+    void draw_casters(bool static_casters) const;
+
+    struct caster
+    {
+        draw_function draw;
+        bool is_static;
+    };
+
+    std::function<void(int pass)> bind_target_;
+    int pass_count_;
+    GLenum texture_target_;
+    GLuint target_texture_;
+    int width_;
+    int height_;
+    int layers_;
+    GLuint texture_id_;
+    std::vector<GLuint> fbo_id_; // one per pass
+    std::vector<caster> casters_;
+    bool valid_ = false;
+    bool target_stale_ = true;
+};
+
+} // namespace gl
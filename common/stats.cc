@@ -0,0 +1,41 @@
+#include "stats.h"
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace gl::stats {
+
+namespace {
+
+constexpr const auto ReportInterval = 120; // frames
+
+std::map<std::string, long, std::less<>> counters;
+int frame_count = 0;
+
+} // namespace
+
+void add(std::string_view counter, long value)
+{
+    auto it = counters.find(counter);
+    if (it == counters.end())
+        it = counters.emplace(std::string(counter), 0).first;
+    it->second += value;
+}
+
+void end_frame()
+{
+    if (counters.empty())
+        return;
+
+    if (++frame_count < ReportInterval)
+        return;
+
+    for (auto &[name, total] : counters) {
+        std::printf("%s: %.1f/frame\n", name.c_str(), static_cast<double>(total) / frame_count);
+        total = 0;
+    }
+    frame_count = 0;
+}
+
+} // namespace gl::stats
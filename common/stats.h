@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string_view>
+
+namespace gl::stats {
+
+// Adds to a named per-frame counter (triangles drawn, API calls, ...).
+void add(std::string_view counter, long value);
+
+// Closes the current frame. Every ReportInterval frames the per-frame averages of all
+// counters touched so far are printed to stdout.
+void end_frame();
+
+} // namespace gl::stats
@@ -0,0 +1,72 @@
+#include "weighted_oit.h"
+
+#include "framebuffer.h"
+
+namespace gl {
+
+weighted_oit::weighted_oit()
+{
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    composite_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/blur.vert");
+    composite_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/oit_composite.frag");
+    composite_program_.link();
+}
+
+weighted_oit::~weighted_oit() = default;
+
+void weighted_oit::begin(int width, int height) const
+{
+    if (!target_ || target_->width() != width || target_->height() != height) {
+        framebuffer_desc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.color = { { AccumulationFormat }, { RevealageFormat } };
+        target_ = std::make_unique<framebuffer>(desc);
+    }
+
+    const auto *screen = framebuffer::screen();
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, screen ? screen->handle() : 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target_->handle());
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    target_->bind();
+    glViewport(0, 0, width, height);
+
+    constexpr GLfloat NoColor[] = { 0, 0, 0, 0 };
+    constexpr GLfloat AllRevealed[] = { 1, 1, 1, 1 };
+    glClearBufferfv(GL_COLOR, 0, NoColor);
+    glClearBufferfv(GL_COLOR, 1, AllRevealed);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void weighted_oit::end() const
+{
+    glDepthMask(GL_TRUE);
+
+    framebuffer::unbind();
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    quad_.bind();
+    composite_program_.bind();
+    composite_program_.set_uniform("accumulation", 0);
+    composite_program_.set_uniform("revealage", 1);
+    glActiveTexture(GL_TEXTURE0);
+    target_->bind_texture(0);
+    glActiveTexture(GL_TEXTURE1);
+    target_->bind_texture(1);
+    glActiveTexture(GL_TEXTURE0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+} // namespace gl
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "shader_program.h"
+#include "geometry.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gl {
+
+class framebuffer;
+
+// Weighted blended order-independent transparency (McGuire and Bavoil, "Weighted
+// Blended Order-Independent Transparency", JCGT 2013). Translucent fragments are added
+// up in an RGBA16F accumulation target, weighted by depth so nearer ones dominate,
+// while an R8 revealage target multiplies up how much of the background shows through.
+// A full screen pass then composites the weighted average over the screen, so
+// translucent geometry is drawn once, in any order and with both faces, without
+// sorting anything.
+//
+// Fragment shaders include common/shaders/weighted_oit.glsl and write through
+// writeTranslucent(); built without shader_defines() the same shader blends normally,
+// for a back to front sorted reference.
+class weighted_oit : private noncopyable
+{
+public:
+    static constexpr auto AccumulationFormat = GL_RGBA16F;
+    static constexpr auto RevealageFormat = GL_R8;
+
+    weighted_oit();
+    ~weighted_oit();
+
+    // #defines for programs that include weighted_oit.glsl
+    static std::vector<std::string> shader_defines() { return { "WEIGHTED_OIT" }; }
+
+    // Binds the accumulation and revealage targets with the blending they need. The
+    // depth of the screen (24 bit depth, 8 bit stencil) is copied over first, so the
+    // translucent geometry is hidden behind opaque geometry drawn before; depth writes
+    // stay off until end().
+    void begin(int width, int height) const;
+
+    // Composites the translucent layers over the screen and restores the usual state
+    // (depth writes on, GL_SRC_ALPHA/GL_ONE_MINUS_SRC_ALPHA blending).
+    void end() const;
+
+private:
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    geometry quad_;
+    shader_program composite_program_;
+    mutable std::unique_ptr<framebuffer> target_; // reallocated when the size changes
+};
+
+} // namespace gl
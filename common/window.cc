@@ -1,6 +1,8 @@
 #include "window.h"
 
 #include "panic.h"
+#include "caps.h"
+#include "render_target_pool.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,7 +11,7 @@
 
 namespace gl {
 
-window::window(int width, int height, const char *title)
+window::window(int width, int height, const char *title, int samples)
     : width_(width)
     , height_(height)
 {
@@ -21,13 +23,14 @@ window::window(int width, int height, const char *title)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 16);
+    glfwWindowHint(GLFW_SAMPLES, samples);
     window_ = glfwCreateWindow(width, height, title, nullptr, nullptr);
 
     glfwMakeContextCurrent(window_);
     glfwSwapInterval(1);
 
     glewInit();
+    detect_caps();
 
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(
@@ -38,6 +41,7 @@ window::window(int width, int height, const char *title)
 
 window::~window()
 {
+    render_targets().clear();
     glfwDestroyWindow(window_);
     glfwTerminate();
 }
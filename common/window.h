@@ -9,7 +9,9 @@ namespace gl {
 class window : private noncopyable
 {
 public:
-    window(int width, int height, const char *title);
+    // samples of the default framebuffer; gl::demo asks for none and antialiases
+    // offscreen instead
+    window(int width, int height, const char *title, int samples = 16);
     ~window();
 
     int width() const { return width_; }
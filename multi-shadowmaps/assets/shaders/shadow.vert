@@ -2,11 +2,35 @@
 
 layout(location=0) in vec3 position;
 
+struct Light
+{
+    vec4 position;
+    mat4 viewProjection;
+    vec4 atlasRect;
+};
+
+layout (std430, binding=0) buffer Lights
+{
+    Light lights[];
+};
+
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+
+out float gl_ClipDistance[4];
 
 void main(void)
 {
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+    Light light = lights[gl_InstanceID];
+    vec4 p = light.viewProjection * modelMatrix * vec4(position, 1.0);
+
+    // clip to the light's own [-1, 1] square...
+    gl_ClipDistance[0] = p.w + p.x;
+    gl_ClipDistance[1] = p.w - p.x;
+    gl_ClipDistance[2] = p.w + p.y;
+    gl_ClipDistance[3] = p.w - p.y;
+
+    // ...and move that square onto its atlas tile
+    vec2 tileCenter = 2.0 * light.atlasRect.xy - 1.0 + light.atlasRect.zw;
+    p.xy = p.xy * light.atlasRect.zw + tileCenter * p.w;
+    gl_Position = p;
 }
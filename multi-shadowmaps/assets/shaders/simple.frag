@@ -1,6 +1,9 @@
 #version 450 core
 
-uniform sampler2DArrayShadow shadowMapTexture;
+#include "shadow_sampling.glsl"
+#include "light_clusters.glsl"
+
+uniform sampler2DShadow shadowMapTexture;
 uniform vec3 eyePosition;
 uniform int lightCount;
 
@@ -8,6 +11,7 @@ struct Light
 {
     vec4 position;
     mat4 viewProjection;
+    vec4 atlasRect;
 };
 
 layout (std430, binding=0) buffer Lights
@@ -18,11 +22,21 @@ layout (std430, binding=0) buffer Lights
 in vec3 vs_normal;
 in vec3 vs_position;
 in vec4 vs_color;
+in float vs_viewDepth;
 
 const vec3 ambient = vec3(0.05);
 
 out vec4 frag_color;
 
+// light space coordinates moved into the light's atlas tile, kept far enough from its
+// edges that the filter doesn't reach into the neighbouring tiles
+vec3 atlasCoords(vec3 projCoords, vec4 atlasRect)
+{
+    float margin = float(SHADOW_PCF_SIZE / 2 + 1) / float(textureSize(shadowMapTexture, 0).x);
+    vec2 uv = clamp(atlasRect.xy + projCoords.xy * atlasRect.zw, atlasRect.xy + margin, atlasRect.xy + atlasRect.zw - margin);
+    return vec3(uv, projCoords.z);
+}
+
 vec3 lightModel()
 {
     const mat4 shadowMatrix = mat4(0.5, 0.0, 0.0, 0.0,
@@ -39,12 +53,22 @@ vec3 lightModel()
         // shadow
         vec4 positionInLightSpace = shadowMatrix * lights[i].viewProjection * vec4(vs_position, 1.0);
         vec3 projCoords = positionInLightSpace.xyz / positionInLightSpace.w;
-        vec4 textureIndex = vec4(projCoords.xy, float(i), projCoords.z);
-        float shadowFactor = texture(shadowMapTexture, textureIndex);
+        float shadow = shadowFactor(shadowMapTexture, atlasCoords(projCoords, lights[i].atlasRect));
 
-        lightIntensity += shadowFactor * intensity;
+        lightIntensity += shadow * intensity;
     }
-    return ambient + lightIntensity * vs_color.xyz;
+    // unshadowed point lights, only those binned into this fragment's cluster
+    vec3 pointLighting = vec3(0.0);
+    int cluster = clusterIndex(gl_FragCoord.xy, vs_viewDepth);
+    uint count = clusterLightCount(cluster);
+    for (uint i = 0; i < count; ++i)
+    {
+        PointLight light = clusterLight(cluster, i);
+        vec3 toLight = normalize(light.positionRadius.xyz - vs_position);
+        pointLighting += light.color.rgb * max(dot(vs_normal, toLight), 0.0) * pointLightAttenuation(light, vs_position);
+    }
+
+    return ambient + (vec3(lightIntensity) + pointLighting) * vs_color.xyz;
 }
 
 void main(void)
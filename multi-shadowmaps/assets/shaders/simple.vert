@@ -11,11 +11,13 @@ uniform mat4 projectionMatrix;
 out vec3 vs_position;
 out vec3 vs_normal;
 out vec4 vs_color;
+out float vs_viewDepth;
 
 void main(void)
 {
     vs_position = vec3(modelMatrix * vec4(position, 1.0));
     vs_normal = normalize(mat3(modelMatrix) * normal); // not quite correct
     vs_color = vec4(1.0);
+    vs_viewDepth = -(viewMatrix * modelMatrix * vec4(position, 1.0)).z;
     gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
 }
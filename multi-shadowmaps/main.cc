@@ -5,8 +5,13 @@
 #include "shader_program.h"
 #include "util.h"
 #include "buffer.h"
-#include "multi_shadow_buffer.h"
+#include "shadow_atlas.h"
+#include "shadow_cache.h"
+#include "light_clusters.h"
+#include "light_frustum.h"
 #include "tween.h"
+#include "render_target_pool.h"
+#include "stats.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -21,12 +26,15 @@
 #include <boost/algorithm/string.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <random>
 #include <fstream>
 
 // #define DUMP_FRAMES
+// hundreds of point lights on top of the shadowed ones
+// #define STRESS_TEST
 
 constexpr const auto CycleDuration = 3.f;
 #ifdef DUMP_FRAMES
@@ -44,10 +52,18 @@ public:
         geometry_.set_data(verts_);
     }
 
-    void render() const
+    void render(int instance_count = 1) const
     {
         geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        glDrawArraysInstanced(GL_TRIANGLES, 0, verts_.size(), instance_count);
+    }
+
+    gl::bounding_box bounds() const
+    {
+        gl::bounding_box box;
+        for (const auto &v : verts_)
+            box.add(std::get<0>(v));
+        return box;
     }
 
 private:
@@ -78,10 +94,18 @@ public:
         geometry_.set_data(verts_);
     }
 
-    void render() const
+    void render(int instance_count = 1) const
     {
         geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        glDrawArraysInstanced(GL_TRIANGLES, 0, verts_.size(), instance_count);
+    }
+
+    gl::bounding_box bounds() const
+    {
+        gl::bounding_box box;
+        for (const auto &v : verts_)
+            box.add(std::get<0>(v));
+        return box;
     }
 
 private:
@@ -147,13 +171,20 @@ private:
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    // one atlas for all the lights; -s overrides it
+    static constexpr auto DefaultShadowSize = 2048;
+
+    Demo(int window_width, int window_height, const gl::shadow_buffer_desc &shadow_desc)
         : window_width_(window_width)
         , window_height_(window_height)
         , mesh_(new Mesh("assets/meshes/monkey.obj"))
         , plane_(new Plane(glm::vec3(0, 0, -2), glm::vec3(3, 0, 0), glm::vec3(0, 4, 0)))
+        , atlas_(shadow_desc)
+        , shadow_cache_(atlas_.buffer())
+        , clusters_(PointLightCount)
     {
         initialize_lights();
+        initialize_point_lights();
         initialize_shader();
     }
 
@@ -170,33 +201,145 @@ private:
         lights_.emplace_back(glm::vec3(5, -5, 9));
         lights_.emplace_back(glm::vec3(3, 3, 6));
         lights_.emplace_back(glm::vec3(-3, -2, 8));
+        lights_.emplace_back(glm::vec3(-9, 1, 12));
+        lights_.emplace_back(glm::vec3(8, 6, 14));
+        lights_.emplace_back(glm::vec3(1, -10, 16));
+        lights_.emplace_back(glm::vec3(-12, -9, 20));
+
+        // The monkey spins around y, so its box covers every orientation; with that
+        // nothing the lights see changes and the projections only depend on the tile sizes.
+        const auto monkey = mesh_->bounds();
+        float radius = 0;
+        for (const auto &c : monkey.corners())
+            radius = std::max(radius, glm::length(glm::vec2(c.x, c.z)));
+        monkey_bounds_ = gl::bounding_box{ glm::vec3(-radius, monkey.min.y, -radius),
+                                           glm::vec3(radius, monkey.max.y, radius) };
+
+        light_buffer_.reset(new gl::buffer<BufferLight>(GL_SHADER_STORAGE_BUFFER, lights_.size(),
+                                                     gl::buffer_storage::stream));
+
+        // the plane's depth is rendered only when the atlas is repacked, the monkey
+        // every frame
+        shadow_cache_.add_caster([this] { render_plane_shadow(); }, true);
+        shadow_cache_.add_caster([this] { render_monkey_shadow(); }, false);
+    }
 
-        shadow_buffer_.reset(new gl::multi_shadow_buffer(ShadowWidth, ShadowHeight, lights_.size()));
-        std::vector<BufferLight> buffer;
-        buffer.reserve(lights_.size());
-        std::transform(lights_.begin(), lights_.end(), std::back_inserter(buffer), [](const Light &light) {
-            return BufferLight{ glm::vec4(light.position, 1.0), light.projection * light.view };
-        });
-        light_buffer_.reset(new gl::buffer<BufferLight>(GL_SHADER_STORAGE_BUFFER, buffer.data(), buffer.size()));
+    void initialize_point_lights()
+    {
+        // scattered over the plane and around the monkey, orbiting the z axis at
+        // different speeds
+        std::mt19937 generator;
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (int i = 0; i < PointLightCount; ++i) {
+            PointLight light;
+            light.orbit_radius = 0.3f + 3.0f * unit(generator);
+            light.phase = 2.0f * M_PI * unit(generator);
+            light.speed = 0.2f + 0.8f * unit(generator);
+            light.height = -1.8f + 2.8f * unit(generator);
+            light.radius = PointLightRadius * (0.5f + unit(generator));
+            light.color = glm::vec3(unit(generator), unit(generator), unit(generator)) * PointLightIntensity;
+            point_lights_.push_back(light);
+        }
     }
 
     void initialize_shader()
     {
+        // one instance per light, each moved into its own atlas tile
         shadow_program_.add_shader(GL_VERTEX_SHADER, "assets/shaders/shadow.vert");
         shadow_program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/shadow.frag");
         shadow_program_.link();
 
         program_.add_shader(GL_VERTEX_SHADER, "assets/shaders/simple.vert");
-        program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/simple.frag");
+        auto defines = clusters_.shader_defines();
+        defines.push_back("SHADOW_PCF_SIZE 3");
+        program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/simple.frag", defines);
         program_.link();
     }
 
+    // Gives every light a tile in proportion to how much of the screen its shadow can
+    // fall on and to how close it is, and refits the projections to the new tiles if
+    // anything moved.
+    void update_atlas() const
+    {
+        const auto camera_view_projection = projection() * view();
+        const std::vector<gl::bounding_box> casters = { monkey_bounds_ };
+        const std::vector<gl::bounding_box> receivers = { plane_->bounds(), monkey_bounds_ };
+
+        auto scene = plane_->bounds();
+        scene.add(monkey_bounds_);
+        const auto scene_center = 0.5f * (scene.min + scene.max);
+
+        tile_sizes_.resize(lights_.size());
+        for (std::size_t i = 0; i < lights_.size(); ++i) {
+            const auto coverage = gl::screen_coverage(camera_view_projection, shadow_bounds(lights_[i].position));
+            const auto distance = glm::distance(lights_[i].position, scene_center);
+            const auto ideal = atlas_.max_tile_size() * std::sqrt(coverage) * std::min(1.0f, NearLightDistance / distance);
+            tile_sizes_[i] = atlas_.tile_size(ideal, tile_sizes_[i]);
+        }
+
+        if (!atlas_.pack(tile_sizes_))
+            return;
+
+        std::vector<BufferLight> buffer;
+        buffer.reserve(lights_.size());
+        for (std::size_t i = 0; i < lights_.size(); ++i) {
+            const auto &light = lights_[i];
+            // the light looks at the origin from its position
+            const auto frustum = gl::fit_directional_light(-light.position, camera_view_projection, casters,
+                                                           receivers, atlas_.tile(i).size);
+            buffer.push_back({ glm::vec4(light.position, 1.0), frustum.view_projection(), atlas_.uv_rect(i) });
+        }
+        light_buffer_->set_sub_data(0, buffer.data(), buffer.size());
+
+        shadow_cache_.invalidate();
+    }
+
+    // The monkey and the shadow it casts on the plane, the only place where the light's
+    // shadow map detail shows: corners of its bounds projected along the light direction
+    // onto the plane, clipped to the plane. Low lights cast long shadows and get more.
+    gl::bounding_box shadow_bounds(const glm::vec3 &light_position) const
+    {
+        const auto plane = plane_->bounds();
+        const auto direction = -glm::normalize(light_position);
+
+        auto bounds = monkey_bounds_;
+        if (direction.z < 0) {
+            gl::bounding_box shadow;
+            for (const auto &corner : monkey_bounds_.corners()) {
+                const auto t = (plane.max.z - corner.z) / direction.z;
+                auto p = corner + t * direction;
+                p.z = plane.max.z; // exactly on it, the plane's box is flat
+                shadow.add(p);
+            }
+            const auto on_plane = gl::bounding_box::intersection(shadow, plane);
+            if (!on_plane.empty())
+                bounds.add(on_plane);
+        }
+        return bounds;
+    }
+
+    void update_point_lights() const
+    {
+        std::vector<gl::point_light> lights;
+        lights.reserve(point_lights_.size());
+        for (const auto &light : point_lights_) {
+            const auto angle = light.phase + light.speed * cur_time_;
+            const auto position = glm::vec3(light.orbit_radius * std::cos(angle), light.orbit_radius * std::sin(angle), light.height);
+            lights.push_back({ glm::vec4(position, light.radius), glm::vec4(light.color, 1.0f) });
+        }
+        clusters_.set_lights(lights);
+        clusters_.update(view(), projection(), NearPlane, ClusterDepth);
+    }
+
     void render() const
     {
         const auto light_position = glm::vec3(-4, 4, 5); // glm::vec3(-2 * cosf(cur_time_), -2 * sinf(cur_time_), 5);
 
         const auto model = glm::mat4(1.0);
-        const auto monkey_model = glm::rotate(glm::mat4(1.0), cur_time_, glm::vec3(0, 1, 0));
+        const auto monkey_model = this->monkey_model();
+
+        update_atlas();
+        update_point_lights();
 
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
@@ -205,33 +348,29 @@ private:
 
         // render shadow maps
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
+        glViewport(0, 0, atlas_.size(), atlas_.size());
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
-        for (int i = 0; i < lights_.size(); ++i)
-        {
-            const auto &light = lights_[i];
-
-            shadow_buffer_->bind(i);
+        // keeps every light's triangles inside its tile, see shadow.vert
+        for (int i = 0; i < 4; ++i)
+            glEnable(GL_CLIP_DISTANCE0 + i);
 
-            glClear(GL_DEPTH_BUFFER_BIT);
+        // all lights in one pass, light matrices and tiles come from the Lights buffer
 
-            shadow_program_.bind();
-            shadow_program_.set_uniform("viewMatrix", light.view);
-            shadow_program_.set_uniform("projectionMatrix", light.projection);
+        shadow_program_.bind();
 
-            shadow_program_.set_uniform("modelMatrix", model);
-            plane_->render();
+        shadow_cache_.update([this](int) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_buffer_->handle());
+        });
 
-            shadow_program_.set_uniform("modelMatrix", model * monkey_model);
-            mesh_->render();
-        }
+        for (int i = 0; i < 4; ++i)
+            glDisable(GL_CLIP_DISTANCE0 + i);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
 
-        shadow_buffer_->unbind();
+        atlas_.buffer().unbind();
 
         // render cube
 
@@ -239,22 +378,21 @@ private:
         glClearColor(0.75, 0.75, 0.75, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        // const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
-        const auto view_pos = glm::vec3(2, 2, 7);
-        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        const auto projection = this->projection();
+        const auto view = this->view();
 
-        shadow_buffer_->bind_texture();
+        atlas_.buffer().bind_texture();
 
         program_.bind();
         program_.set_uniform("modelMatrix", model);
         program_.set_uniform("viewMatrix", view);
         program_.set_uniform("projectionMatrix", projection);
-        program_.set_uniform("eyePosition", view_pos);
+        program_.set_uniform("eyePosition", ViewPosition);
         program_.set_uniform("lightPosition", light_position);
         program_.set_uniform("lightCount", static_cast<int>(lights_.size()));
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_buffer_->handle());
+        clusters_.set_uniforms(program_, window_width_, window_height_);
+        clusters_.bind();
 
         program_.set_uniform("modelMatrix", model);
         plane_->render();
@@ -263,8 +401,53 @@ private:
         mesh_->render();
     }
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    glm::mat4 projection() const
+    {
+        return glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, NearPlane, 100.f);
+    }
+
+    glm::mat4 view() const
+    {
+        return glm::lookAt(ViewPosition, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    }
+
+    glm::mat4 monkey_model() const
+    {
+        return glm::rotate(glm::mat4(1.0), cur_time_, glm::vec3(0, 1, 0));
+    }
+
+    // shadow casters, one instance per light
+
+    void render_plane_shadow() const
+    {
+        shadow_program_.set_uniform("modelMatrix", glm::mat4(1.0));
+        plane_->render(lights_.size());
+    }
+
+    void render_monkey_shadow() const
+    {
+        shadow_program_.set_uniform("modelMatrix", monkey_model());
+        mesh_->render(lights_.size());
+    }
+
+    static inline const glm::vec3 ViewPosition{ 2, 2, 7 };
+
+    static constexpr auto NearPlane = 0.1f;
+    // depth range of the light clusters, the whole scene is well within it
+    static constexpr auto ClusterDepth = 20.0f;
+
+#ifdef STRESS_TEST
+    static constexpr auto PointLightCount = 512;
+    static constexpr auto PointLightRadius = 0.6f;
+    static constexpr auto PointLightIntensity = 0.3f;
+#else
+    static constexpr auto PointLightCount = 32;
+    static constexpr auto PointLightRadius = 1.2f;
+    static constexpr auto PointLightIntensity = 0.6f;
+#endif
+
+    // lights closer than this to the scene get the full tile size its coverage asks for
+    static constexpr auto NearLightDistance = 10.0f;
 
     int window_width_;
     int window_height_;
@@ -273,17 +456,15 @@ private:
     gl::shader_program shadow_program_;
     std::unique_ptr<Mesh> mesh_;
     std::unique_ptr<Plane> plane_;
-    std::unique_ptr<gl::multi_shadow_buffer> shadow_buffer_;
+    gl::bounding_box monkey_bounds_;
+    mutable gl::shadow_atlas atlas_;
+    mutable std::vector<int> tile_sizes_;
     struct Light
     {
         glm::vec3 position;
-        glm::mat4 projection;
-        glm::mat4 view;
         Light(const glm::vec3 &position)
             : position(position)
         {
-            projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 12.5f);
-            view = glm::lookAt(position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
         }
     };
     std::vector<Light> lights_;
@@ -291,15 +472,30 @@ private:
     {
         glm::vec4 position;
         glm::mat4 viewProjection;
+        glm::vec4 atlasRect; // uv offset and scale of the light's tile
     };
     std::unique_ptr<gl::buffer<BufferLight>> light_buffer_;
+    mutable gl::shadow_cache shadow_cache_;
+    struct PointLight
+    {
+        float orbit_radius;
+        float phase;
+        float speed;
+        float height;
+        float radius;
+        glm::vec3 color;
+    };
+    std::vector<PointLight> point_lights_;
+    mutable gl::light_clusters clusters_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
+    const auto shadow_desc = gl::parse_shadow_arguments(argc, argv, Demo::DefaultShadowSize);
+
     gl::window w(window_width, window_height, "demo");
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
@@ -313,7 +509,7 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, shadow_desc);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -327,6 +523,8 @@ int main()
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
             d.render_and_step(dt);
+            gl::render_targets().end_frame();
+            gl::stats::end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -116,7 +116,7 @@ public:
     demo(int window_width, int window_height)
         : window_width_(window_width)
         , window_height_(window_height)
-        , states_(GL_SHADER_STORAGE_BUFFER, GridSize * GridSize * GridSize)
+        , states_(GL_SHADER_STORAGE_BUFFER, GridSize * GridSize * GridSize, gl::buffer_storage::stream)
         , cube_(new mesh("assets/meshes/beveled-cube.obj"))
     {
         initialize_shader();
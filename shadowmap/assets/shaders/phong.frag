@@ -1,13 +1,13 @@
 #version 450 core
 
-uniform sampler2DShadow shadowMapTexture;
+#include "cascaded_shadows.glsl"
+
 uniform vec3 eyePosition;
 uniform vec3 lightPosition;
 
 in vec3 vs_normal;
 in vec3 vs_position;
 in vec4 vs_color;
-in vec4 vs_positionInLightSpace;
 
 const vec3 ambient = vec3(0.05);
 const float shininess = 1.0;
@@ -39,30 +39,7 @@ vec3 phong()
 
 float shadowFactor()
 {
-#if 0
-    float factor = textureProj(shadowMapTexture, vs_positionInLightSpace);
-#else
-    vec3 projCoords = vs_positionInLightSpace.xyz / vs_positionInLightSpace.w;
-    vec2 uvCoords = projCoords.xy;
-
-    ivec2 texDim = textureSize(shadowMapTexture, 0).xy;
-    float xOffset = 1.0 / float(texDim.x);
-    float yOffset = 1.0 / float(texDim.y);
-
-    const float range = 1;
-    const float shadowFactor = 0.25;
-
-    float factor = 0.0;
-    for (float y = -range; y <= range; ++y)
-    {
-        for (float x = -range; x <= range; ++x)
-        {
-            factor += texture(shadowMapTexture, vec3(projCoords + vec3(x * xOffset, y * yOffset, 0)));
-        }
-    }
-    factor /= ((range * 2 + 1) * (range * 2 + 1));
-#endif
-    return min(factor + 0.5, 1.0);
+    return min(cascadedShadow(vs_position) + 0.5, 1.0);
 }
 
 void main(void)
@@ -1,12 +1,22 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 layout(location=0) in vec3 position;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+struct Draw
+{
+    mat4 modelMatrix;
+};
+
+layout(std430, binding=0) buffer Draws
+{
+    Draw draws[];
+};
+
+uniform mat4 viewProjectionMatrix;
 
 void main(void)
 {
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+    mat4 modelMatrix = draws[gl_DrawIDARB].modelMatrix;
+    gl_Position = viewProjectionMatrix * modelMatrix * vec4(position, 1.0);
 }
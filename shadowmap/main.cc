@@ -1,12 +1,18 @@
 #include "panic.h"
 
 #include "window.h"
-#include "geometry.h"
+#include "geometry_arena.h"
+#include "render_queue.h"
 #include "shader_program.h"
 #include "util.h"
 #include "buffer.h"
-#include "shadow_buffer.h"
+#include "cascaded_shadow_map.h"
+#include "shadow_cache.h"
 #include "tween.h"
+#include "mesh_lod.h"
+#include "stats.h"
+#include "depth_prepass.h"
+#include "render_target_pool.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -35,19 +41,37 @@ constexpr const auto FramesPerSecond = 40;
 constexpr const auto FramesPerSecond = 60;
 #endif
 
+using Vertex = std::tuple<glm::vec3, glm::vec3>; // position, normal
+using GeometryArena = gl::geometry_arena<Vertex>;
+
+// matches struct Draw in phong.vert/shadow.vert
+struct DrawData
+{
+    glm::mat4 model_matrix;
+};
+
+using RenderQueue = gl::render_queue<DrawData>;
+
 class Plane
 {
 public:
-    Plane(const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
+    Plane(GeometryArena &arena, const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
+        : arena_(arena)
     {
         initialize_geometry(center, up, side);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
-    void render() const
+    ~Plane()
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        arena_.free(handle_);
+    }
+
+    // returns the number of triangles queued
+    int render(RenderQueue &queue, const gl::shader_program &program, const DrawData &data) const
+    {
+        queue.push(arena_, GL_TRIANGLES, program, handle_, data);
+        return handle_.count / 3;
     }
 
 private:
@@ -64,24 +88,38 @@ private:
         verts_.push_back({center - up - side, normal});
     }
 
-    using vertex = std::tuple<glm::vec3, glm::vec3>; // position, normal, texuv
-    std::vector<vertex> verts_;
-    gl::geometry geometry_;
+    GeometryArena &arena_;
+    std::vector<Vertex> verts_;
+    gl::geometry_handle handle_;
 };
 
 class Mesh
 {
 public:
-    Mesh(const char *file)
+    Mesh(GeometryArena &arena, const char *file)
+        : arena_(arena)
     {
         initialize_geometry(file);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
-    void render() const
+    ~Mesh()
+    {
+        arena_.free(handle_);
+    }
+
+    int lod_count() const { return lods_.size(); }
+
+    // bounding sphere in model space
+    const glm::vec3 &center() const { return center_; }
+    float radius() const { return radius_; }
+
+    // returns the number of triangles queued
+    int render(RenderQueue &queue, const gl::shader_program &program, const DrawData &data, int lod) const
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        const auto &level = lods_[lod];
+        queue.push(arena_, GL_TRIANGLES, program, handle_.sub_range(level.first, level.count), data);
+        return level.count / 3;
     }
 
 private:
@@ -92,13 +130,7 @@ private:
             panic("failed to open %s\n", file);
 
         std::vector<glm::vec3> positions;
-        std::vector<glm::vec3> normals;
-        struct vertex {
-            int position_index;
-            int normal_index;
-        };
-        using face = std::vector<vertex>;
-        std::vector<face> faces;
+        std::vector<unsigned> indices;
 
         std::string line;
         while (std::getline(ifs, line)) {
@@ -109,52 +141,88 @@ private:
             if (tokens.front() == "v") {
                 assert(tokens.size() == 4);
                 positions.emplace_back(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
-            } else if (tokens.front() == "vn") {
-                assert(tokens.size() == 4);
-                normals.emplace_back(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
             } else if (tokens.front() == "f") {
-                face f;
+                std::vector<unsigned> face;
                 for (auto it = std::next(tokens.begin()); it != tokens.end(); ++it) {
                     std::vector<std::string> components;
                     boost::split(components, *it, boost::is_any_of("/"), boost::token_compress_off);
                     assert(components.size() == 3);
-                    f.push_back({ std::stoi(components[0]) - 1, std::stoi(components[2]) - 1 });
+                    face.push_back(std::stoi(components[0]) - 1);
+                }
+                for (size_t i = 1; i < face.size() - 1; ++i) {
+                    indices.push_back(face[0]);
+                    indices.push_back(face[i]);
+                    indices.push_back(face[i + 1]);
                 }
-                faces.push_back(f);
             }
         }
 
-        for (const auto &face : faces) {
-            for (size_t i = 1; i < face.size() - 1; ++i) {
-                const auto to_vertex = [&positions, &normals](const auto &vertex) {
-                    return std::make_tuple(positions[vertex.position_index], normals[vertex.normal_index]);
-                };
-                const auto v0 = to_vertex(face[0]);
-                const auto v1 = to_vertex(face[i]);
-                const auto v2 = to_vertex(face[i + 1]);
-                verts_.push_back(v0);
-                verts_.push_back(v1);
-                verts_.push_back(v2);
+        // the mesh is flat shaded, so normals can be recomputed for every LOD from the
+        // simplified faces
+
+        for (const auto &level : gl::build_lod_chain(positions, indices, MaxLods)) {
+            const int first = verts_.size();
+            for (size_t i = 0; i < level.indices.size(); i += 3) {
+                const auto &v0 = positions[level.indices[i]];
+                const auto &v1 = positions[level.indices[i + 1]];
+                const auto &v2 = positions[level.indices[i + 2]];
+                const auto normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+                verts_.emplace_back(v0, normal);
+                verts_.emplace_back(v1, normal);
+                verts_.emplace_back(v2, normal);
             }
+            lods_.push_back({ first, static_cast<int>(verts_.size()) - first });
+        }
+
+        auto min_corner = positions.front();
+        auto max_corner = positions.front();
+        for (const auto &p : positions) {
+            min_corner = glm::min(min_corner, p);
+            max_corner = glm::max(max_corner, p);
         }
+        center_ = 0.5f * (min_corner + max_corner);
+        radius_ = 0;
+        for (const auto &p : positions)
+            radius_ = std::max(radius_, glm::distance(p, center_));
     }
 
-    using vertex = std::tuple<glm::vec3, glm::vec3>; // position, normal, texuv
-    std::vector<vertex> verts_;
-    gl::geometry geometry_;
+    static constexpr auto MaxLods = 5;
+
+    struct Lod
+    {
+        int first;
+        int count;
+    };
+    std::vector<Lod> lods_;
+    glm::vec3 center_;
+    float radius_;
+
+    GeometryArena &arena_;
+    std::vector<Vertex> verts_;
+    gl::geometry_handle handle_;
 };
 
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    static constexpr auto DefaultShadowSize = 1024; // per cascade, -s overrides it
+    static constexpr auto CascadeCount = 4;
+
+    Demo(int window_width, int window_height, const gl::shadow_buffer_desc &shadow_desc)
         : window_width_(window_width)
         , window_height_(window_height)
-        , mesh_(new Mesh("assets/meshes/monkey.obj"))
-        , plane_(new Plane(glm::vec3(0, 0, -2), glm::vec3(3, 0, 0), glm::vec3(0, 4, 0)))
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , arena_(ArenaVertices, ArenaVertices)
+        , queue_(MaxDraws, DrawDataBinding)
+        , mesh_(new Mesh(arena_, "assets/meshes/monkey.obj"))
+        , plane_(new Plane(arena_, glm::vec3(0, 0, -2), glm::vec3(3, 0, 0), glm::vec3(0, 4, 0)))
+        , shadow_map_(shadow_desc)
+        , shadow_cache_(shadow_map_.buffer())
     {
         initialize_shader();
+
+        // the plane never moves, so its depth only has to be rendered when the cascades change
+        shadow_cache_.add_caster([this] { render_plane_shadow(); }, true);
+        shadow_cache_.add_caster([this] { render_monkey_shadow(); }, false);
     }
 
     void render_and_step(float dt)
@@ -171,8 +239,10 @@ private:
         shadow_program_.link();
 
         program_.add_shader(GL_VERTEX_SHADER, "assets/shaders/phong.vert");
-        program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/phong.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/phong.frag", { "SHADOW_PCF_SIZE 3" });
         program_.link();
+
+        gl::depth_prepass::build_program(depth_program_, "assets/shaders/phong.vert");
     }
 
     void render() const
@@ -180,41 +250,47 @@ private:
         const auto light_position = glm::vec3(-4, 4, 5); // glm::vec3(-2 * cosf(cur_time_), -2 * sinf(cur_time_), 5);
 
         const auto model = glm::mat4(1.0);
-        const auto monkey_model = glm::rotate(glm::mat4(1.0), cur_time_, glm::vec3(0, 1, 0));
+        const auto monkey_model = this->monkey_model();
 
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
 
         glDisable(GL_CULL_FACE);
 
-        // render shadow
+        const auto projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+        // const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
+        const auto view_pos = glm::vec3(2, 2, 7);
+        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
-        shadow_buffer_.bind();
+        // render shadow
 
-        glClear(GL_DEPTH_BUFFER_BIT);
+        const auto camera = gl::camera_frustum{ view, glm::radians(45.0f),
+                                                static_cast<float>(window_width_) / window_height_, 0.1f, 100.f };
+        if (shadow_map_.update(camera, ShadowDistance, -light_position))
+            shadow_cache_.invalidate();
 
-        const auto light_projection =
-                // glm::perspective(glm::radians(45.0f), static_cast<float>(ShadowWidth) / ShadowHeight, 0.1f, 100.f);
-                glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 12.5f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        glViewport(0, 0, shadow_map_.size(), shadow_map_.size());
 
         shadow_program_.bind();
-        shadow_program_.set_uniform("viewMatrix", light_view);
-        shadow_program_.set_uniform("projectionMatrix", light_projection);
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
-        shadow_program_.set_uniform("modelMatrix", model);
-        plane_->render();
+        shadow_triangles_ = 0;
 
-        shadow_program_.set_uniform("modelMatrix", model * monkey_model);
-        mesh_->render();
+        shadow_cache_.update(
+                [this](int cascade) {
+                    shadow_cascade_ = cascade;
+                    shadow_program_.set_uniform("viewProjectionMatrix", shadow_map_.cascade(cascade).view_projection);
+                },
+                [this](int) { queue_.submit(); });
+
+        gl::stats::add("shadow pass triangles", shadow_triangles_);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
 
-        shadow_buffer_.unbind();
+        shadow_map_.unbind();
 
         // render cube
 
@@ -222,48 +298,109 @@ private:
         glClearColor(0.75, 0.75, 0.75, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        // const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
-        const auto view_pos = glm::vec3(2, 2, 7);
-        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        const auto lod = mesh_lod(projection * view * model * monkey_model, window_height_, 0);
+        const auto render_scene = [&](const gl::shader_program &program) {
+            int triangles = 0;
+            triangles += plane_->render(queue_, program, DrawData{ model });
+            triangles += mesh_->render(queue_, program, DrawData{ model * monkey_model }, lod);
+            queue_.submit();
+            return triangles;
+        };
+
+        if (depth_prepass_.enabled()) {
+            depth_prepass_.begin_depth_pass();
+            depth_program_.bind();
+            depth_program_.set_uniform("viewMatrix", view);
+            depth_program_.set_uniform("projectionMatrix", projection);
+            gl::stats::add("depth pass triangles", render_scene(depth_program_));
+        }
+
+        depth_prepass_.begin_shading_pass();
 
-        shadow_buffer_.bind_texture();
+        shadow_map_.bind_texture();
 
         program_.bind();
-        program_.set_uniform("modelMatrix", model);
         program_.set_uniform("viewMatrix", view);
         program_.set_uniform("projectionMatrix", projection);
         program_.set_uniform("eyePosition", view_pos);
         program_.set_uniform("lightPosition", light_position);
-        program_.set_uniform("lightViewProjection", light_projection * light_view);
-        program_.set_uniform("shadowMapTexture", 0);
+        program_.set_uniform("cascadeShadowTexture", 0);
+        shadow_map_.set_uniforms(program_);
+
+        const auto triangles = render_scene(program_);
+
+        depth_prepass_.end();
+
+        gl::stats::add("main pass triangles", triangles);
+    }
+
+    glm::mat4 monkey_model() const
+    {
+        return glm::rotate(glm::mat4(1.0), cur_time_, glm::vec3(0, 1, 0));
+    }
 
-        program_.set_uniform("modelMatrix", model);
-        plane_->render();
+    // shadow casters, queued by shadow_cache_ with the current cascade's matrix set up
+    // and submitted together at the end of the pass
 
-        program_.set_uniform("modelMatrix", model * monkey_model);
-        mesh_->render();
+    void render_plane_shadow() const
+    {
+        shadow_triangles_ += plane_->render(queue_, shadow_program_, DrawData{ glm::mat4(1.0) });
     }
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    void render_monkey_shadow() const
+    {
+        const auto model = monkey_model();
+        const auto &light_view_projection = shadow_map_.cascade(shadow_cascade_).view_projection;
+        const auto lod = mesh_lod(light_view_projection * model, shadow_map_.size(), ShadowLodBias);
+        shadow_triangles_ += mesh_->render(queue_, shadow_program_, DrawData{ model }, lod);
+    }
+
+    int mesh_lod(const glm::mat4 &mvp, int viewport_height, int bias) const
+    {
+        const auto size = gl::projected_size(mvp, mesh_->center(), mesh_->radius(), viewport_height);
+        return gl::select_lod(size, FullDetailSize, mesh_->lod_count(), bias);
+    }
+
+    // projected height in pixels above which the monkey is drawn at full detail
+    static constexpr auto FullDetailSize = 400.0f;
+    // shadow casters can get away with coarser meshes than what's seen directly
+    static constexpr auto ShadowLodBias = 1;
+
+    // cascades cover the view frustum up to this distance from the camera
+    static constexpr auto ShadowDistance = 20.0f;
+
+    // lay down depth first, so the cascade filtering only runs for visible fragments
+    static constexpr auto UseDepthPrepass = true;
+
+    static constexpr auto ArenaVertices = 16 * 1024;
+    static constexpr auto MaxDraws = 16;
+    static constexpr auto DrawDataBinding = 0;
 
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
+    gl::shader_program depth_program_;
+    gl::depth_prepass depth_prepass_{ UseDepthPrepass };
+    GeometryArena arena_;
+    mutable RenderQueue queue_;
     std::unique_ptr<Mesh> mesh_;
     std::unique_ptr<Plane> plane_;
-    gl::shadow_buffer shadow_buffer_;
+    mutable gl::cascaded_shadow_map shadow_map_;
+    mutable gl::shadow_cache shadow_cache_;
+    mutable int shadow_cascade_ = 0;
+    mutable int shadow_triangles_ = 0;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
+    auto shadow_desc = gl::parse_shadow_arguments(argc, argv, Demo::DefaultShadowSize);
+    shadow_desc.layers = Demo::CascadeCount;
+
     gl::window w(window_width, window_height, "demo");
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
@@ -277,7 +414,7 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, shadow_desc);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -291,6 +428,8 @@ int main()
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
             d.render_and_step(dt);
+            gl::render_targets().end_frame();
+            gl::stats::end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
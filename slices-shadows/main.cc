@@ -1,11 +1,16 @@
 #include "panic.h"
 
 #include "window.h"
-#include "geometry.h"
+#include "geometry_arena.h"
 #include "shader_program.h"
 #include "util.h"
 #include "tween.h"
+#include "render_target_pool.h"
+#include "depth_prepass.h"
+#include "stats.h"
 #include "shadow_buffer.h"
+#include "shadow_cache.h"
+#include "light_frustum.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -117,20 +122,35 @@ auto split(const Mesh &mesh, const Plane &plane)
 }
 
 using Vertex = std::tuple<glm::vec3, glm::vec3, glm::vec3>; // position / normal / color
+using GeometryArena = gl::geometry_arena<Vertex>;
 
 class PlaneGeometry
 {
 public:
-    PlaneGeometry(const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
+    PlaneGeometry(GeometryArena &arena, const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
+        : arena_(arena)
     {
         initialize_geometry(center, up, side);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
+    ~PlaneGeometry()
+    {
+        arena_.free(handle_);
+    }
+
+    // assumes the arena is bound
     void render() const
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        arena_.draw(GL_TRIANGLES, handle_);
+    }
+
+    gl::bounding_box bounds() const
+    {
+        gl::bounding_box box;
+        for (const auto &v : verts_)
+            box.add(std::get<0>(v));
+        return box;
     }
 
 private:
@@ -148,23 +168,30 @@ private:
         verts_.push_back({center - up - side, normal, color});
     }
 
+    GeometryArena &arena_;
     std::vector<Vertex> verts_;
-    gl::geometry geometry_;
+    gl::geometry_handle handle_;
 };
 
 class MeshGeometry
 {
 public:
-    MeshGeometry(const Mesh &m)
+    MeshGeometry(GeometryArena &arena, const Mesh &m)
+        : arena_(arena)
     {
         initialize_geometry(m);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
+    ~MeshGeometry()
+    {
+        arena_.free(handle_);
+    }
+
+    // assumes the arena is bound
     void render() const
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        arena_.draw(GL_TRIANGLES, handle_);
     }
 
 private:
@@ -183,8 +210,9 @@ private:
         }
     }
 
+    GeometryArena &arena_;
     std::vector<Vertex> verts_;
-    gl::geometry geometry_;
+    gl::geometry_handle handle_;
 };
 
 static Mesh make_cube()
@@ -267,12 +295,12 @@ struct Leaf : Node
     std::unique_ptr<MeshGeometry> mesh;
 };
 
-std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
+std::unique_ptr<Node> build_tree(GeometryArena &arena, const Mesh &mesh, int depth)
 {
     constexpr const auto MaxDepth = 7;
     if (depth == MaxDepth) {
         auto leaf = new Leaf;
-        leaf->mesh = std::make_unique<MeshGeometry>(mesh);
+        leaf->mesh = std::make_unique<MeshGeometry>(arena, mesh);
         return std::unique_ptr<Node>(leaf);
     }
 
@@ -289,7 +317,7 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 
     if (front_mesh.empty() || back_mesh.empty()) {
         auto leaf = new Leaf;
-        leaf->mesh = std::make_unique<MeshGeometry>(mesh);
+        leaf->mesh = std::make_unique<MeshGeometry>(arena, mesh);
         return std::unique_ptr<Node>(leaf);
     }
 
@@ -298,8 +326,8 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 
     auto split = new Split;
     split->normal = plane.normal;
-    split->front = build_tree(front_mesh, depth + 1);
-    split->back = build_tree(back_mesh, depth + 1);
+    split->front = build_tree(arena, front_mesh, depth + 1);
+    split->back = build_tree(arena, back_mesh, depth + 1);
     split->start_explode = StartExplode + 0.25 * depth;
     split->start_implode = StartImplode - 0.5 * 0.125 * depth;
     return std::unique_ptr<Node>(split);
@@ -308,14 +336,29 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    // with the light frustum fitted to what's visible this matches the old 2048 map;
+    // -s overrides it
+    static constexpr auto DefaultShadowSize = 1024;
+
+    Demo(int window_width, int window_height, const gl::shadow_buffer_desc &shadow_desc)
         : window_width_(window_width)
         , window_height_(window_height)
-        , plane_(glm::vec3(0, 0, -2.5), glm::vec3(10, 0, 0), glm::vec3(0, 10, 0))
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , arena_(ArenaVertices, ArenaVertices)
+        , plane_(arena_, glm::vec3(0, 0, -2.5), glm::vec3(10, 0, 0), glm::vec3(0, 10, 0))
+        , shadow_buffer_(shadow_desc)
+        , shadow_cache_(shadow_buffer_)
     {
         initialize_shader();
-        split_tree_ = build_tree(make_cube(), 0);
+        split_tree_ = build_tree(arena_, make_cube(), 0);
+
+        // the light is fixed, so the plane's depth is rendered once
+        shadow_cache_.add_caster([this] {
+            shadow_program_.set_uniform("modelMatrix", glm::mat4(1.0));
+            plane_.render();
+        }, true);
+        shadow_cache_.add_caster([this] {
+            split_tree_->render(shadow_program_, tree_model(), fmod(cur_time_, CycleDuration));
+        }, false);
     }
 
     void render_and_step(float dt)
@@ -324,7 +367,7 @@ public:
         cur_time_ += dt;
         if (cur_time_ >= CycleDuration) {
             cur_time_ -= CycleDuration;
-            split_tree_ = build_tree(make_cube(), 0);
+            split_tree_ = build_tree(arena_, make_cube(), 0);
         }
     }
 
@@ -336,8 +379,10 @@ private:
         shadow_program_.link();
 
         program_.add_shader(GL_VERTEX_SHADER, "shaders/phong.vert");
-        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/phong.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/phong.frag", { "SHADOW_POISSON", "SHADOW_POISSON_RADIUS 5.0" });
         program_.link();
+
+        gl::depth_prepass::build_program(depth_program_, "shaders/phong.vert");
     }
 
     void render() const
@@ -351,18 +396,22 @@ private:
 
         // render shadow
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
-        shadow_buffer_.bind();
+        glViewport(0, 0, shadow_buffer_.width(), shadow_buffer_.height());
 
-        glClear(GL_DEPTH_BUFFER_BIT);
+        const auto projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+        const auto view_pos = glm::vec3(0, 0, 7);
+        const auto view_up = glm::vec3(0, 1, 0);
+        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
 
-        const auto light_projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 12.5f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        // the exploding pieces stay within TreeRadius of the origin
+        const auto tree_bounds = gl::bounding_box::from_sphere(glm::vec3(0), TreeRadius);
+        const auto light_frustum = gl::fit_directional_light(-light_position, projection * view, { tree_bounds },
+                                                             { plane_.bounds(), tree_bounds }, shadow_buffer_.width());
+        const auto &light_projection = light_frustum.projection;
+        const auto &light_view = light_frustum.view;
 
-        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
-        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1)) *
-            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(1, 0, 0)) *
-            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(0, 1, 0));
+        const auto model = tree_model();
 
         shadow_program_.bind();
         shadow_program_.set_uniform("viewMatrix", light_view);
@@ -371,9 +420,9 @@ private:
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
-        shadow_program_.set_uniform("modelMatrix", glm::mat4(1.0));
-        plane_.render();
-        split_tree_->render(shadow_program_, model, fmod(cur_time_, CycleDuration));
+        arena_.bind();
+
+        shadow_cache_.update([](int) {});
 
         glDisable(GL_POLYGON_OFFSET_FILL);
 
@@ -386,11 +435,19 @@ private:
         glClearColor(0.75, 0.75, 0.75, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        const auto view_pos = glm::vec3(0, 0, 7);
-        const auto view_up = glm::vec3(0, 1, 0);
-        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
+        const auto time = fmod(cur_time_, CycleDuration);
+
+        if (depth_prepass_.enabled()) {
+            depth_prepass_.begin_depth_pass();
+            depth_program_.bind();
+            depth_program_.set_uniform("projectionMatrix", projection);
+            depth_program_.set_uniform("viewMatrix", view);
+            depth_program_.set_uniform("modelMatrix", glm::mat4(1.0));
+            plane_.render();
+            split_tree_->render(depth_program_, model, time);
+        }
+
+        depth_prepass_.begin_shading_pass();
 
         shadow_buffer_.bind_texture();
 
@@ -404,27 +461,50 @@ private:
 
         program_.set_uniform("modelMatrix", glm::mat4(1.0));
         plane_.render();
-        split_tree_->render(program_, model, fmod(cur_time_, CycleDuration));
+        split_tree_->render(program_, model, time);
+
+        depth_prepass_.end();
     }
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    glm::mat4 tree_model() const
+    {
+        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
+        return glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1)) *
+            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(1, 0, 0)) *
+            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(0, 1, 0));
+    }
+
+    // cube corners plus the largest offset the splits can add up to
+    static constexpr auto TreeRadius = 5.25f;
+
+    // room for two fully split trees, since the next one is built before the previous
+    // one is released
+    static constexpr auto ArenaVertices = 128 * 1024;
+
+    // the pieces overlap a lot on screen, and Poisson filtering isn't cheap
+    static constexpr auto UseDepthPrepass = true;
 
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
+    GeometryArena arena_;
     std::unique_ptr<Node> split_tree_;
     PlaneGeometry plane_;
     gl::shadow_buffer shadow_buffer_;
+    mutable gl::shadow_cache shadow_cache_;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
+    gl::shader_program depth_program_;
+    gl::depth_prepass depth_prepass_{ UseDepthPrepass };
 };
 
-int main()
+int main(int argc, char *argv[])
 {
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
+    const auto shadow_desc = gl::parse_shadow_arguments(argc, argv, Demo::DefaultShadowSize);
+
     srand(time(nullptr));
 
     gl::window w(window_width, window_height, "Demo");
@@ -440,7 +520,7 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, shadow_desc);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -454,6 +534,8 @@ int main()
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
             d.render_and_step(dt);
+            gl::render_targets().end_frame();
+            gl::stats::end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -14,6 +14,9 @@ out vec3 vs_normal;
 out vec3 vs_color;
 out vec4 vs_positionInLightSpace;
 
+// the depth prepass runs this too, and has to land on exactly the same depths
+invariant gl_Position;
+
 void main(void)
 {
     const mat4 shadowMatrix = mat4(0.5, 0.0, 0.0, 0.0,
@@ -1,7 +1,8 @@
 #include "panic.h"
 
 #include "window.h"
-#include "geometry.h"
+#include "geometry_arena.h"
+#include "render_queue.h"
 #include "shader_program.h"
 #include "util.h"
 #include "tween.h"
@@ -114,19 +115,28 @@ auto split(const Mesh &mesh, const Plane &plane)
     return std::make_tuple(front_mesh, back_mesh);
 }
 
+using vertex = std::tuple<glm::vec3, glm::vec3, glm::vec3>;
+using geometry_arena = gl::geometry_arena<vertex>;
+
 class mesh_geometry
 {
 public:
-    mesh_geometry(const Mesh &m)
+    mesh_geometry(geometry_arena &arena, const Mesh &m)
+        : arena_(arena)
     {
         initialize_geometry(m);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
-    void render() const
+    ~mesh_geometry()
+    {
+        arena_.free(handle_);
+    }
+
+    template<typename DrawDataT>
+    void render(gl::render_queue<DrawDataT> &queue, const gl::shader_program &program, const DrawDataT &data) const
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        queue.push(arena_, GL_TRIANGLES, program, handle_, data);
     }
 
 private:
@@ -145,9 +155,9 @@ private:
         }
     }
 
-    using vertex = std::tuple<glm::vec3, glm::vec3, glm::vec3>;
+    geometry_arena &arena_;
     std::vector<vertex> verts_;
-    gl::geometry geometry_;
+    gl::geometry_handle handle_;
 };
 
 static Mesh make_cube()
@@ -182,18 +192,25 @@ static Mesh make_cube()
 }
 
 static std::unique_ptr<gl::shader_program> program_;
-static glm::mat4 projection;
-static glm::mat4 view;
+
+// matches struct Draw in sphere.vert
+struct DrawData
+{
+    glm::mat4 model_matrix;
+    glm::mat4 normal_matrix; // mat3, padded to std430 column alignment
+};
+
+using RenderQueue = gl::render_queue<DrawData>;
 
 struct Node
 {
     virtual ~Node() = default;
-    virtual void render(const glm::mat4 &m, float time) const = 0;
+    virtual void render(RenderQueue &queue, const glm::mat4 &m, float time) const = 0;
 };
 
 struct Split : Node
 {
-    void render(const glm::mat4 &m, float time) const override
+    void render(RenderQueue &queue, const glm::mat4 &m, float time) const override
     {
         constexpr const auto MaxOffset = 0.3f;
 
@@ -213,8 +230,8 @@ struct Split : Node
             }
         }();
 
-        front->render(m * glm::translate(glm::mat4(1), -offset * normal), time);
-        back->render(m * glm::translate(glm::mat4(1), offset * normal), time);
+        front->render(queue, m * glm::translate(glm::mat4(1), -offset * normal), time);
+        back->render(queue, m * glm::translate(glm::mat4(1), offset * normal), time);
     }
 
     glm::vec3 normal;
@@ -225,30 +242,24 @@ struct Split : Node
 
 struct Leaf : Node
 {
-    void render(const glm::mat4 &model, float) const override
+    void render(RenderQueue &queue, const glm::mat4 &model, float) const override
     {
-        const auto mvp = projection * view * model;
-        program_->set_uniform(program_->uniform_location("mvp"), mvp);
-
         glm::mat3 model_normal = model;
         model_normal = glm::inverse(model_normal);
         model_normal = glm::transpose(model_normal);
 
-        program_->set_uniform(program_->uniform_location("normalMatrix"), model_normal);
-        program_->set_uniform(program_->uniform_location("modelMatrix"), view * model);
-
-        mesh->render();
+        mesh->render(queue, *program_, DrawData{ model, glm::mat4(model_normal) });
     }
 
     std::unique_ptr<mesh_geometry> mesh;
 };
 
-std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
+std::unique_ptr<Node> build_tree(geometry_arena &arena, const Mesh &mesh, int depth)
 {
     constexpr const auto MaxDepth = 7;
     if (depth == MaxDepth) {
         auto leaf = new Leaf;
-        leaf->mesh = std::make_unique<mesh_geometry>(mesh);
+        leaf->mesh = std::make_unique<mesh_geometry>(arena, mesh);
         return std::unique_ptr<Node>(leaf);
     }
 
@@ -265,7 +276,7 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 
     if (front_mesh.empty() || back_mesh.empty()) {
         auto leaf = new Leaf;
-        leaf->mesh = std::make_unique<mesh_geometry>(mesh);
+        leaf->mesh = std::make_unique<mesh_geometry>(arena, mesh);
         return std::unique_ptr<Node>(leaf);
     }
 
@@ -274,8 +285,8 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 
     auto split = new Split;
     split->normal = plane.normal;
-    split->front = build_tree(front_mesh, depth + 1);
-    split->back = build_tree(back_mesh, depth + 1);
+    split->front = build_tree(arena, front_mesh, depth + 1);
+    split->back = build_tree(arena, back_mesh, depth + 1);
     split->start_explode = StartExplode + 0.25 * depth;
     split->start_implode = StartImplode - 0.5 * 0.125 * depth;
     return std::unique_ptr<Node>(split);
@@ -287,9 +298,11 @@ public:
     demo(int window_width, int window_height)
         : window_width_(window_width)
         , window_height_(window_height)
+        , arena_(ArenaVertices, ArenaVertices)
+        , queue_(MaxDraws, DrawDataBinding)
     {
         initialize_shader();
-        split_tree_ = build_tree(make_cube(), 0);
+        split_tree_ = build_tree(arena_, make_cube(), 0);
     }
 
     void render_and_step(float dt)
@@ -324,24 +337,34 @@ private:
 
         glDisable(GL_CULL_FACE);
 
-        projection =
+        const auto projection =
                 glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
         const auto view_pos = glm::vec3(3.5, -3.5, 3.5);
         const auto view_up = glm::vec3(0, 1, 0);
-        view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
+        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
 
         const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
         const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 2, 1));
 
         program_->bind();
         program_->set_uniform(program_->uniform_location("global_light"), glm::vec3(5, -5, 5));
+        program_->set_uniform(program_->uniform_location("viewMatrix"), view);
+        program_->set_uniform(program_->uniform_location("projectionMatrix"), projection);
 
-        split_tree_->render(model, fmod(cur_time_, CycleDuration));
+        split_tree_->render(queue_, model, fmod(cur_time_, CycleDuration));
+        queue_.submit();
     }
 
+    // room for every leaf of a fully split tree
+    static constexpr auto ArenaVertices = 64 * 1024;
+    static constexpr auto MaxDraws = 1 << 7;
+    static constexpr auto DrawDataBinding = 0;
+
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
+    geometry_arena arena_;
+    mutable RenderQueue queue_;
     std::unique_ptr<Node> split_tree_;
 };
 
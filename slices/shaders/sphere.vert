@@ -1,12 +1,23 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec3 color;
 
-uniform mat4 mvp;
-uniform mat3 normalMatrix;
-uniform mat4 modelMatrix;
+struct Draw
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+};
+
+layout(std430, binding=0) buffer Draws
+{
+    Draw draws[];
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
 
 out vec3 vs_position;
 out vec3 vs_normal;
@@ -14,8 +25,9 @@ out vec3 vs_color;
 
 void main(void)
 {
-    vs_position = vec3(modelMatrix * vec4(position, 1.0));
-    vs_normal = normalMatrix * normal;
+    vec4 viewPosition = viewMatrix * draws[gl_DrawIDARB].modelMatrix * vec4(position, 1.0);
+    vs_position = vec3(viewPosition);
+    vs_normal = mat3(draws[gl_DrawIDARB].normalMatrix) * normal;
     vs_color = color;
-    gl_Position = mvp * vec4(position, 1.0);
+    gl_Position = projectionMatrix * viewPosition;
 }
@@ -0,0 +1,135 @@
+#include "window.h"
+#include "buffer.h"
+#include "instance_sort.h"
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// Times instance_sort on grids of instances of growing size, radix sorted on the GPU
+// and std::sorted on the CPU (upload included), and prints a table. The GPU result of
+// each size is read back and checked to be a permutation in back to front order.
+
+namespace {
+
+constexpr int GridSizes[] = { 4, 8, 16, 24, 32, 48, 64 };
+constexpr auto WarmupIterations = 4;
+constexpr auto Iterations = 32;
+constexpr auto VertexCount = 36;
+
+// a different camera angle every iteration, so the input is never already sorted
+glm::mat4 model_view(int iteration)
+{
+    const auto view = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    return glm::rotate(view, 0.37f * iteration, glm::normalize(glm::vec3(1, 2, 3)));
+}
+
+// microseconds per sort
+double time_gpu_sort(const gl::instance_sort &sort, const gl::buffer<glm::vec4> &instances, int count)
+{
+    for (int i = 0; i < WarmupIterations; ++i)
+        sort.sort(instances.handle(), count, model_view(i), VertexCount);
+
+    GLuint query;
+    glGenQueries(1, &query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int i = 0; i < Iterations; ++i)
+        sort.sort(instances.handle(), count, model_view(i), VertexCount);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    glDeleteQueries(1, &query);
+
+    return elapsed / (1000.0 * Iterations);
+}
+
+double time_cpu_sort(const gl::instance_sort &sort, const std::vector<glm::vec3> &positions)
+{
+    for (int i = 0; i < WarmupIterations; ++i)
+        sort.sort_on_cpu(positions, model_view(i), VertexCount);
+    glFinish();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < Iterations; ++i)
+        sort.sort_on_cpu(positions, model_view(i), VertexCount);
+    glFinish();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::micro>(elapsed).count() / Iterations;
+}
+
+bool check_gpu_sort(const gl::instance_sort &sort, const gl::buffer<glm::vec4> &instances,
+                    const std::vector<glm::vec3> &positions)
+{
+    const int count = positions.size();
+    const auto matrix = model_view(0);
+    sort.sort(instances.handle(), count, matrix, VertexCount);
+
+    std::vector<GLuint> indices(count);
+    sort.sorted_indices().get_sub_data(0, indices.data(), count);
+
+    std::vector<bool> seen(count);
+    auto previous_depth = -1e30f;
+    for (auto index : indices) {
+        if (index >= static_cast<GLuint>(count) || seen[index])
+            return false;
+        seen[index] = true;
+
+        // the GPU may round the last bit differently
+        const auto depth = (matrix * glm::vec4(positions[index], 1)).z;
+        if (depth < previous_depth - 1e-5f)
+            return false;
+        previous_depth = depth;
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    gl::window w(256, 256, "sort-bench");
+
+    const auto max_size = GridSizes[std::size(GridSizes) - 1];
+    gl::instance_sort sort(max_size * max_size * max_size, sizeof(glm::vec4), 0);
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> jitter(-0.25f, 0.25f);
+
+    std::printf("%8s %10s %10s %10s %8s\n", "grid", "instances", "gpu us", "cpu us", "check");
+
+    for (auto size : GridSizes) {
+        std::vector<glm::vec3> positions;
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                for (int k = 0; k < size; ++k) {
+                    const auto offset = glm::vec3(jitter(generator), jitter(generator), jitter(generator));
+                    const auto cell = glm::vec3(i, j, k) + offset;
+                    positions.push_back(cell / static_cast<float>(size) - 0.5f);
+                }
+            }
+        }
+
+        std::vector<glm::vec4> data;
+        for (const auto &position : positions)
+            data.emplace_back(position, 1);
+        const gl::buffer<glm::vec4> instances(GL_SHADER_STORAGE_BUFFER, data.data(), data.size(),
+                                              gl::buffer_storage::immutable);
+
+        const int count = positions.size();
+        const auto gpu_time = time_gpu_sort(sort, instances, count);
+        const auto cpu_time = time_cpu_sort(sort, positions);
+        const auto ok = check_gpu_sort(sort, instances, positions);
+
+        std::printf("%6d^3 %10d %10.1f %10.1f %8s\n", size, count, gpu_time, cpu_time, ok ? "ok" : "FAILED");
+        std::fflush(stdout);
+    }
+}
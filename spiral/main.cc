@@ -4,6 +4,10 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "weighted_oit.h"
+#include "reference_comparison.h"
+#include "render_target_pool.h"
+#include "stats.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -16,6 +20,7 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <numeric>
 
 // #define DUMP_FRAMES
 
@@ -29,10 +34,10 @@ constexpr const auto FramesPerSecond = 60;
 class sphere_geometry
 {
 public:
-    sphere_geometry()
+    explicit sphere_geometry(gl::buffer_storage storage)
     {
         initialize_geometry();
-        geometry_.set_data(verts_, indices_);
+        geometry_.set_data(verts_, indices_, storage);
     }
 
     void render() const
@@ -41,6 +46,27 @@ public:
         glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, nullptr);
     }
 
+    // Reorders the triangles back to front by the view space depth of their centroids.
+    // Needs stream storage.
+    void sort_back_to_front(const glm::mat4 &model_view) const
+    {
+        const auto triangle_count = centroids_.size();
+        depths_.resize(triangle_count);
+        for (std::size_t i = 0; i < triangle_count; ++i)
+            depths_[i] = (model_view * glm::vec4(centroids_[i], 1)).z;
+
+        order_.resize(triangle_count);
+        std::iota(order_.begin(), order_.end(), 0);
+        std::sort(order_.begin(), order_.end(), [this](int a, int b) { return depths_[a] < depths_[b]; });
+
+        auto *indices = geometry_.map_indices<GLuint>();
+        for (auto triangle : order_) {
+            std::copy_n(&indices_[3 * triangle], 3, indices);
+            indices += 3;
+        }
+        geometry_.unmap_indices();
+    }
+
 private:
     void initialize_geometry()
     {
@@ -82,11 +108,21 @@ private:
                 indices_.push_back(i0);
             }
         }
+
+        for (std::size_t i = 0; i < indices_.size(); i += 3) {
+            const auto &p0 = std::get<0>(verts_[indices_[i]]);
+            const auto &p1 = std::get<0>(verts_[indices_[i + 1]]);
+            const auto &p2 = std::get<0>(verts_[indices_[i + 2]]);
+            centroids_.push_back((p0 + p1 + p2) / 3.0f);
+        }
     }
 
     using vertex = std::tuple<glm::vec3, glm::vec3, glm::vec2>; // position, normal, texuv
     std::vector<vertex> verts_;
     std::vector<GLuint> indices_;
+    std::vector<glm::vec3> centroids_; // by triangle
+    mutable std::vector<float> depths_;
+    mutable std::vector<int> order_;
     gl::geometry geometry_;
 };
 
@@ -96,26 +132,42 @@ public:
     demo(int window_width, int window_height)
         : window_width_(window_width)
         , window_height_(window_height)
-        , sphere_(new sphere_geometry)
+        , sphere_(new sphere_geometry(UseSortedReference ? gl::buffer_storage::stream : gl::buffer_storage::immutable))
+        , comparison_("spiral")
     {
         initialize_shader();
     }
 
     void render_and_step(float dt)
     {
-        render(program_);
+        if (CompareWithReference)
+            comparison_.render(window_width_, window_height_, [this] { render(false); }, [this] { render(true); });
+        else
+            render(UseWeightedOit);
         cur_time_ += dt;
     }
 
 private:
+    // Weighted blended OIT draws the spiral once, both faces at a time. Otherwise its
+    // triangles are sorted back to front on the CPU every frame, which is the reference
+    // OIT is compared against.
+    static constexpr auto UseWeightedOit = true;
+    // renders both ways every frame and reports the difference to gl::stats
+    static constexpr auto CompareWithReference = false;
+    static constexpr auto UseSortedReference = !UseWeightedOit || CompareWithReference;
+
     void initialize_shader()
     {
         program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
         program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
         program_.link();
+
+        oit_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        oit_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag", gl::weighted_oit::shader_defines());
+        oit_program_.link();
     }
 
-    void render(const gl::shader_program &program) const
+    void render(bool weighted_oit) const
     {
         glViewport(0, 0, window_width_, window_height_);
         glClearColor(0.5, 0.5, 0.5, 0);
@@ -129,7 +181,8 @@ private:
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        glEnable(GL_CULL_FACE);
+        // both faces in a single draw, the sort or OIT takes care of the order
+        glDisable(GL_CULL_FACE);
 
         const auto projection =
                 glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
@@ -145,6 +198,14 @@ private:
         model_normal = glm::inverse(model_normal);
         model_normal = glm::transpose(model_normal);
 
+        const auto &program = weighted_oit ? oit_program_ : program_;
+        if (weighted_oit) {
+            oit_.begin(window_width_, window_height_);
+        } else {
+            sphere_->sort_back_to_front(view * model);
+            glDepthMask(GL_FALSE);
+        }
+
         program.bind();
 
         constexpr const auto LocationMvp = 0;
@@ -160,18 +221,22 @@ private:
         const auto a = static_cast<float>(cur_time_) / CycleDuration; // sinf(cur_time_ * 2.f * M_PI / cycle_duration);
         program.set_uniform(LocationUvOffset, glm::vec2(-a, a));
 
-        glCullFace(GL_FRONT);
         sphere_->render();
 
-        glCullFace(GL_BACK);
-        sphere_->render();
+        if (weighted_oit)
+            oit_.end();
+        else
+            glDepthMask(GL_TRUE);
     }
 
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
     gl::shader_program program_;
+    gl::shader_program oit_program_;
     std::unique_ptr<sphere_geometry> sphere_;
+    gl::weighted_oit oit_;
+    gl::reference_comparison comparison_;
 };
 
 int main()
@@ -212,6 +277,8 @@ int main()
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
             d.render_and_step(dt);
+            gl::render_targets().end_frame();
+            gl::stats::end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -1,5 +1,7 @@
 #version 450 core
 
+#include "weighted_oit.glsl"
+
 layout(location=3) uniform vec3 globalLight;
 layout(location=4) uniform vec2 uvOffset;
 
@@ -7,8 +9,6 @@ in vec3 vs_position;
 in vec3 vs_normal;
 in vec2 vs_uv;
 
-out vec4 frag_color;
-
 const float ambient = 0.15;
 
 float random(vec2 st)
@@ -47,5 +47,5 @@ void main(void)
     vec3 color = vec3(l);
 
     float v = ambient + max(dot(vs_normal, normalize(globalLight - vs_position)), 0.0);
-    frag_color = vec4(v * color, 0.4);
+    writeTranslucent(vec4(v * color, 0.4));
 }
@@ -1,10 +1,17 @@
 #include "panic.h"
 
 #include "window.h"
-#include "geometry.h"
+#include "geometry_arena.h"
+#include "render_queue.h"
 #include "shader_program.h"
 #include "util.h"
 #include "shadow_buffer.h"
+#include "cube_shadow_buffer.h"
+#include "light_frustum.h"
+#include "gpu_timer.h"
+#include "depth_prepass.h"
+#include "stats.h"
+#include "render_target_pool.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -78,19 +85,39 @@ void subdivide(std::vector<glm::vec3> &points, const glm::vec3 &from, const glm:
     }
 }
 
+using Vertex = std::tuple<glm::vec3, glm::vec3, glm::vec2>; // position, normal, texuv
+using GeometryArena = gl::geometry_arena<Vertex>;
+
+// matches struct Draw in sphere.vert/shadow.vert
+struct DrawData
+{
+    glm::vec4 color;
+    glm::vec2 v_range;
+    GLuint face_mask = 0; // cube shadow faces, see shadow_cube.vert
+    GLuint padding = 0;
+};
+
+using RenderQueue = gl::render_queue<DrawData>;
+
 class PlaneGeometry
 {
 public:
-    PlaneGeometry(const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
+    PlaneGeometry(GeometryArena &arena, const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
+        : arena_(arena)
     {
         initialize_geometry(center, up, side);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
-    void render() const
+    ~PlaneGeometry()
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
+        arena_.free(handle_);
+    }
+
+    void render(RenderQueue &queue, const gl::shader_program &program, const DrawData &data,
+                GLuint instance_count = 1) const
+    {
+        queue.push(arena_, GL_TRIANGLES, program, handle_, data, instance_count);
     }
 
 private:
@@ -107,24 +134,30 @@ private:
         verts_.push_back({center - up - side, normal, {}});
     }
 
-    using vertex = std::tuple<glm::vec3, glm::vec3, glm::vec2>; // position, normal, texuv
-    std::vector<vertex> verts_;
-    gl::geometry geometry_;
+    GeometryArena &arena_;
+    std::vector<Vertex> verts_;
+    gl::geometry_handle handle_;
 };
 
 class StripGeometry
 {
 public:
-    StripGeometry(float angle_offset, float coil_radius)
+    StripGeometry(GeometryArena &arena, float angle_offset, float coil_radius)
+        : arena_(arena)
     {
         initialize(angle_offset, coil_radius);
-        geometry_.set_data(verts_);
+        handle_ = arena_.allocate(verts_);
     }
 
-    void render() const
+    ~StripGeometry()
     {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, verts_.size());
+        arena_.free(handle_);
+    }
+
+    void render(RenderQueue &queue, const gl::shader_program &program, const DrawData &data,
+                GLuint instance_count = 1) const
+    {
+        queue.push(arena_, GL_TRIANGLE_STRIP, program, handle_, data, instance_count);
     }
 
 private:
@@ -200,27 +233,42 @@ private:
         }
     }
 
-    using vertex = std::tuple<glm::vec3, glm::vec3, glm::vec2>; // position, direction, uv
-    std::vector<vertex> verts_;
-    gl::geometry geometry_;
+    GeometryArena &arena_;
+    std::vector<Vertex> verts_; // position, direction, uv
+    gl::geometry_handle handle_;
 };
 
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    // the light's cone is fitted around the strips, so half the old size is enough;
+    // -s overrides it
+    static constexpr auto DefaultShadowSize = 1024;
+
+    Demo(int window_width, int window_height, const gl::shadow_buffer_desc &shadow_desc)
         : window_width_(window_width)
         , window_height_(window_height)
-        , plane_(new PlaneGeometry(glm::vec3(0, 0, -1), glm::vec3(3, 0, 0), glm::vec3(0, 3, 0)))
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , arena_(ArenaVertices, ArenaVertices)
+        , queue_(NumStrips + 1, DrawDataBinding)
+        , plane_(new PlaneGeometry(arena_, glm::vec3(0, 0, -1), glm::vec3(3, 0, 0), glm::vec3(0, 3, 0)))
     {
+        // only the light in use gets a shadow map
+        if (UsePointLight) {
+            cube_shadow_buffer_.reset(new gl::cube_shadow_buffer(shadow_desc));
+            cube_shadow_buffer_->set_light(PointLightPosition, PointLightRange);
+        } else {
+            auto desc = shadow_desc;
+            desc.filter = ShadowFilter;
+            shadow_buffer_.reset(new gl::shadow_buffer(desc));
+        }
+
         initialize_shader();
 
         for (int i = 0; i < NumStrips; ++i)
         {
             const float a = static_cast<float>(i) * 2.0f * M_PI / NumStrips;
             const auto coil_radius = 0.05f + frand() * 0.05f;
-            strips_.emplace_back(new StripGeometry(a, coil_radius));
+            strips_.emplace_back(new StripGeometry(arena_, a, coil_radius));
 
             auto &params = params_[i];
             params.offset = frand();
@@ -244,15 +292,24 @@ private:
         shadow_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/shadow.frag");
         shadow_program_.link();
 
+        const auto cube_defines = gl::cube_shadow_buffer::caster_defines();
+        cube_shadow_program_.add_shader(GL_VERTEX_SHADER, "shaders/shadow_cube.vert", cube_defines);
+        if (!cube_defines.empty())
+            cube_shadow_program_.add_shader(GL_GEOMETRY_SHADER, "shaders/shadow_cube.geom");
+        cube_shadow_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/shadow_cube.frag", cube_defines);
+        cube_shadow_program_.link();
+
         program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
-        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag", { "SHADOW_PCF_SIZE 7" });
         program_.link();
+
+        // the strips discard their gaps, so the depth pass needs sphere.frag too
+        gl::depth_prepass::build_program(depth_program_, "shaders/sphere.vert", "shaders/sphere.frag",
+                                         { "SHADOW_PCF_SIZE 7" });
     }
 
     void render() const
     {
-        const auto light_position = glm::vec3(-1, -1, 3);
-
 #if 0
         const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
         const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0, 1, 0));
@@ -260,34 +317,26 @@ private:
         const auto model = glm::mat4(1.0);
 #endif
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        const auto projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+        const auto view = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
         glDisable(GL_CULL_FACE);
 
         // shadow buffer
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
-        shadow_buffer_.bind();
-
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        const auto light_projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(ShadowWidth) / ShadowHeight, 0.1f, 100.f);
-                // glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 12.5f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-
-        shadow_program_.bind();
-        shadow_program_.set_uniform("viewMatrix", light_view);
-        shadow_program_.set_uniform("projectionMatrix", light_projection);
-        shadow_program_.set_uniform("modelMatrix", model);
+        // moments need the closest caster, and blending would mix them
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
 
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(4, 4);
-        render_strips(shadow_program_, true);
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        const auto light_position = UsePointLight ? PointLightPosition : SpotLightPosition;
 
-        shadow_buffer_.unbind();
+        glm::mat4 light_view_projection(1.0f);
+        if (UsePointLight)
+            render_cube_shadow(model);
+        else
+            light_view_projection = render_spot_shadow(model, projection * view);
 
         // scene
 
@@ -296,42 +345,130 @@ private:
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        const auto view = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
         const auto mvp = projection * view * model;
 
-        shadow_buffer_.bind_texture();
+        // this is where the shadow filtering cost shows up
+        scene_timer_.begin();
+
+        if (depth_prepass_.enabled()) {
+            depth_prepass_.begin_depth_pass();
+            depth_program_.bind();
+            depth_program_.set_uniform("mvp", mvp);
+            render_strips(depth_program_);
+        }
+
+        depth_prepass_.begin_shading_pass();
+
+        // sampler2DShadow, sampler2D and samplerCubeShadow can't share a unit, even if
+        // only one is used
+        const auto use_evsm = !UsePointLight && shadow_buffer_->filter() == gl::shadow_filter::evsm;
+        if (UsePointLight) {
+            glActiveTexture(GL_TEXTURE2);
+            cube_shadow_buffer_->bind_texture();
+        } else {
+            glActiveTexture(use_evsm ? GL_TEXTURE1 : GL_TEXTURE0);
+            shadow_buffer_->bind_texture();
+        }
+        glActiveTexture(GL_TEXTURE0);
 
         program_.bind();
         program_.set_uniform("mvp", mvp);
         program_.set_uniform("modelMatrix", model);
         program_.set_uniform("lightPosition", light_position);
-        program_.set_uniform("lightViewProjection", light_projection * light_view);
+        program_.set_uniform("lightViewProjection", light_view_projection);
         program_.set_uniform("shadowMapTexture", 0);
+        program_.set_uniform("shadowMomentsTexture", 1);
+        program_.set_uniform("cubeShadowTexture", 2);
+        program_.set_uniform("useEvsm", use_evsm ? 1 : 0);
+        program_.set_uniform("useCubeShadow", UsePointLight ? 1 : 0);
+        program_.set_uniform("softEndsOnly", 0);
+        if (UsePointLight)
+            cube_shadow_buffer_->set_uniforms(program_);
+        else
+            shadow_buffer_->set_uniforms(program_);
+
+        render_strips(program_);
+
+        // the depth pass left the soft ends out, so they failed the equal test
+        if (depth_prepass_.enabled()) {
+            glDepthFunc(GL_LEQUAL);
+            program_.set_uniform("softEndsOnly", 1);
+            render_strips(program_);
+        }
 
-        render_strips(program_, false);
+        depth_prepass_.end();
+        scene_timer_.end();
     }
 
-    void render_strips(const gl::shader_program &program, bool shadow) const
+    // returns the light's view projection matrix
+    glm::mat4 render_spot_shadow(const glm::mat4 &model, const glm::mat4 &camera_view_projection) const
     {
+        glViewport(0, 0, shadow_buffer_->width(), shadow_buffer_->height());
+        shadow_buffer_->bind();
+        shadow_buffer_->clear();
+
+        // the strips both cast and receive the shadows
+        const auto strip_bounds = StripBounds.transformed(model);
+        const auto light_frustum =
+                gl::fit_spot_light(SpotLightPosition, camera_view_projection, { strip_bounds }, { strip_bounds });
+
+        shadow_program_.bind();
+        shadow_program_.set_uniform("viewMatrix", light_frustum.view);
+        shadow_program_.set_uniform("projectionMatrix", light_frustum.projection);
+        shadow_program_.set_uniform("modelMatrix", model);
+        shadow_buffer_->set_uniforms(shadow_program_);
+
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(4, 4);
+        render_strips(shadow_program_);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+
+        shadow_buffer_->unbind();
+        shadow_buffer_->prefilter();
+
+        return light_frustum.view_projection();
+    }
+
+    // all six faces in one pass
+    void render_cube_shadow(const glm::mat4 &model) const
+    {
+        glViewport(0, 0, cube_shadow_buffer_->size(), cube_shadow_buffer_->size());
+        cube_shadow_buffer_->bind();
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        // with the light just above the ring the face looking up never gets anything
+        const auto face_mask = cube_shadow_buffer_->face_mask(StripBounds.transformed(model));
+
+        if (face_mask) {
+            cube_shadow_program_.bind();
+            cube_shadow_program_.set_uniform("modelMatrix", model);
+            cube_shadow_buffer_->set_uniforms(cube_shadow_program_);
+
+            render_strips(cube_shadow_program_, face_mask);
+        }
+
+        cube_shadow_buffer_->unbind();
+    }
+
+    // face_mask is only set for cube shadow passes
+    void render_strips(const gl::shader_program &program, unsigned face_mask = 0) const
+    {
+        const auto instance_count = face_mask ? gl::cube_shadow_buffer::instance_count(face_mask) : 1;
+
 #if 0
-        if (!shadow)
-            program.set_uniform("color", glm::vec3(0.75));
-        program.set_uniform("vRange", glm::vec2(-1, -1));
-        plane_->render();
+        plane_->render(queue_, program, DrawData{ glm::vec4(0.75), glm::vec2(-1, -1), face_mask }, instance_count);
 #endif
 
         for (int i = 0; i < strips_.size(); ++i)
         {
             const auto &params = params_[i];
 
-            if (!shadow)
-                program.set_uniform("color", params.color);
-
 #if 1
             auto v_start = fmod(params.offset + cur_time_ * params.speed, 1.0f);
             auto v_end = fmod(v_start + params.length, 1.0f);
@@ -339,22 +476,40 @@ private:
             auto v_start = 0.8f;
             auto v_end = 0.2f;
 #endif
-            program.set_uniform("vRange", glm::vec2(v_start, v_end));
 
-            strips_[i]->render();
+            const auto data = DrawData{ glm::vec4(params.color, 1), glm::vec2(v_start, v_end), face_mask };
+            strips_[i]->render(queue_, program, data, instance_count);
         }
+
+        queue_.submit();
     }
 
     static constexpr auto NumStrips = 40;
+    static constexpr auto ArenaVertices = 64 * 1024;
+    static constexpr auto DrawDataBinding = 0;
+
+    // a point light inside the ring with cube shadows, or the spot light above it
+    static constexpr auto UsePointLight = true;
+    // the soft ends are drawn after the equal tested pass, blended over the strips behind
+    static constexpr auto UseDepthPrepass = true;
+    static inline const glm::vec3 PointLightPosition{ 0.2f, -0.1f, 0.5f };
+    static constexpr auto PointLightRange = 5.0f;
+    static inline const glm::vec3 SpotLightPosition{ -1, -1, 3 };
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    // spot light only: pcf for the old 121-tap loop, to compare the "scene pass us" stats
+    static constexpr auto ShadowFilter = gl::shadow_filter::evsm;
+
+    // unit circle path plus the largest coil radius and tape width
+    static inline const gl::bounding_box StripBounds{ glm::vec3(-1.15f, -1.15f, -0.15f), glm::vec3(1.15f, 1.15f, 0.15f) };
 
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
+    gl::shader_program cube_shadow_program_;
+    GeometryArena arena_;
+    mutable RenderQueue queue_;
     std::vector<std::unique_ptr<StripGeometry>> strips_;
     std::unique_ptr<PlaneGeometry> plane_;
     struct StripParams
@@ -365,14 +520,23 @@ private:
         float length;
     };
     std::array<StripParams, NumStrips> params_;
-    gl::shadow_buffer shadow_buffer_;
+    std::unique_ptr<gl::shadow_buffer> shadow_buffer_;           // spot light
+    std::unique_ptr<gl::cube_shadow_buffer> cube_shadow_buffer_; // point light
+    // the filter being measured is in the name
+    mutable gl::gpu_timer scene_timer_{ UsePointLight ? "scene pass us, cube pcf"
+                                        : ShadowFilter == gl::shadow_filter::evsm ? "scene pass us, spot evsm"
+                                                                                  : "scene pass us, spot pcf" };
+    gl::shader_program depth_program_;
+    gl::depth_prepass depth_prepass_{ UseDepthPrepass };
 };
 
-int main()
+int main(int argc, char *argv[])
 {
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
+    const auto shadow_desc = gl::parse_shadow_arguments(argc, argv, Demo::DefaultShadowSize);
+
     gl::window w(window_width, window_height, "demo");
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
@@ -386,7 +550,7 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, shadow_desc);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -400,6 +564,8 @@ int main()
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
             d.render_and_step(dt);
+            gl::render_targets().end_frame();
+            gl::stats::end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -1,13 +1,17 @@
 #version 450 core
 
+#include "evsm.glsl"
+
 in vec2 vs_uv;
+flat in vec2 vs_vRange;
 
-uniform vec2 vRange;
+// only stored with shadow_filter::evsm, PCF shadow buffers have no color attachment
+out vec4 fragMoments;
 
 void main()
 {
-    float vStart = vRange.x;
-    float vEnd = vRange.y;
+    float vStart = vs_vRange.x;
+    float vEnd = vs_vRange.y;
     if (vStart.x != -1)
     {
         if (vEnd > vStart)
@@ -21,4 +25,6 @@ void main()
                 discard;
         }
     }
+
+    fragMoments = evsmMoments(gl_FragCoord.z);
 }
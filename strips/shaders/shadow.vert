@@ -1,17 +1,31 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 uv;
 
+struct Draw
+{
+    vec4 color;
+    vec2 vRange;
+};
+
+layout(std430, binding=0) buffer Draws
+{
+    Draw draws[];
+};
+
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
 out vec2 vs_uv;
+flat out vec2 vs_vRange;
 
 void main(void)
 {
     vs_uv = uv;
+    vs_vRange = draws[gl_DrawIDARB].vRange;
     gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
 }
@@ -0,0 +1,34 @@
+#version 450 core
+
+#include "cube_shadow.glsl"
+
+#ifdef CUBE_SHADOW_GEOMETRY_SHADER
+#define vs_worldPosition gs_worldPosition
+#define vs_uv gs_uv
+#define vs_vRange gs_vRange
+#endif
+
+in vec3 vs_worldPosition;
+in vec2 vs_uv;
+flat in vec2 vs_vRange;
+
+void main()
+{
+    float vStart = vs_vRange.x;
+    float vEnd = vs_vRange.y;
+    if (vStart.x != -1)
+    {
+        if (vEnd > vStart)
+        {
+            if (vs_uv.y < vStart || vs_uv.y > vEnd)
+                discard;
+        }
+        else
+        {
+            if (vs_uv.y > vEnd && vs_uv.y < vStart)
+                discard;
+        }
+    }
+
+    gl_FragDepth = cubeShadowDepth(vs_worldPosition);
+}
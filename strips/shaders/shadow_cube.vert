@@ -0,0 +1,51 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+#ifndef CUBE_SHADOW_GEOMETRY_SHADER
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
+#include "cube_shadow.glsl"
+
+layout(location=0) in vec3 position;
+layout(location=1) in vec3 normal;
+layout(location=2) in vec2 uv;
+
+struct Draw
+{
+    vec4 color;
+    vec2 vRange;
+    uint faceMask;
+};
+
+layout(std430, binding=0) buffer Draws
+{
+    Draw draws[];
+};
+
+uniform mat4 modelMatrix;
+
+out vec3 vs_worldPosition;
+out vec2 vs_uv;
+flat out vec2 vs_vRange;
+#ifdef CUBE_SHADOW_GEOMETRY_SHADER
+flat out uint vs_faceMask;
+#endif
+
+void main(void)
+{
+    vec4 worldPosition = modelMatrix * vec4(position, 1.0);
+    vs_worldPosition = worldPosition.xyz;
+    vs_uv = uv;
+    vs_vRange = draws[gl_DrawIDARB].vRange;
+
+#ifdef CUBE_SHADOW_GEOMETRY_SHADER
+    // shadow_cube.geom replicates the triangle
+    vs_faceMask = draws[gl_DrawIDARB].faceMask;
+    gl_Position = worldPosition;
+#else
+    // one instance per face the draw reaches
+    int face = cubeShadowFace(draws[gl_DrawIDARB].faceMask, gl_InstanceID);
+    gl_Layer = face;
+    gl_Position = cubeShadowFaceMatrices[face] * worldPosition;
+#endif
+}
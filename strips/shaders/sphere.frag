@@ -1,48 +1,46 @@
 #version 450 core
 
+#include "evsm.glsl"
+#include "shadow_sampling.glsl"
+#include "cube_shadow.glsl"
+
 in vec3 vs_position;
 in vec3 vs_normal;
 in vec2 vs_uv;
 in vec4 vs_positionInLightSpace;
+flat in vec3 vs_color;
+flat in vec2 vs_vRange;
 
 out vec4 fragColor;
 
 uniform sampler2DShadow shadowMapTexture;
+uniform sampler2D shadowMomentsTexture;
+uniform samplerCubeShadow cubeShadowTexture;
+uniform bool useEvsm;
+uniform bool useCubeShadow;
 uniform vec3 lightPosition;
-uniform vec3 color;
-uniform vec2 vRange;
+uniform bool softEndsOnly;
 
 float shadowFactor()
 {
-#if 0
-    float factor = textureProj(shadowMapTexture, vs_positionInLightSpace);
-#else
-    vec3 projCoords = vs_positionInLightSpace.xyz / vs_positionInLightSpace.w;
-    vec2 uvCoords = projCoords.xy;
-
-    ivec2 texDim = textureSize(shadowMapTexture, 0).xy;
-    float xOffset = 1.0 / float(texDim.x);
-    float yOffset = 1.0 / float(texDim.y);
+    if (useCubeShadow)
+        return min(cubeShadowFactor(cubeShadowTexture, vs_position, 0.02) + 0.5, 1.0);
 
-    const float range = 5;
-
-    float factor = 0.0;
-    for (float y = -range; y <= range; ++y)
+    if (useEvsm)
     {
-        for (float x = -range; x <= range; ++x)
-        {
-            factor += texture(shadowMapTexture, vec3(projCoords + vec3(x * xOffset, y * yOffset, 0)));
-        }
+        vec3 projCoords = vs_positionInLightSpace.xyz / vs_positionInLightSpace.w;
+        return min(evsmShadow(shadowMomentsTexture, projCoords) + 0.5, 1.0);
     }
-    factor /= ((range * 2 + 1) * (range * 2 + 1));
-#endif
+
+    vec3 projCoords = vs_positionInLightSpace.xyz / vs_positionInLightSpace.w;
+    float factor = shadowFactor(shadowMapTexture, projCoords);
     return min(factor + 0.5, 1.0);
 }
 
 void main(void)
 {
-    float vStart = vRange.x;
-    float vEnd = vRange.y;
+    float vStart = vs_vRange.x;
+    float vEnd = vs_vRange.y;
     float alpha = 0.0;
     const float border = 0.005;
     if (vStart.x != -1)
@@ -65,6 +63,17 @@ void main(void)
         alpha = 1.0;
     }
 
+#ifdef DEPTH_PREPASS
+    // only the discards matter; the soft ends are left out, they blend over what's behind
+    if (alpha < 1.0)
+        discard;
+    fragColor = vec4(0.0);
+    return;
+#endif
+
+    if (softEndsOnly && alpha >= 1.0)
+        discard;
+
     // float intensity = max(dot(vs_normal, normalize(lightPosition - vs_position)), 0.0);
     float intensity = abs(dot(vs_normal, normalize(lightPosition - vs_position)));
 
@@ -74,5 +83,5 @@ void main(void)
 
     intensity *= shadowFactor();
 
-    fragColor = vec4(intensity * color, alpha);
+    fragColor = vec4(intensity * vs_color, alpha);
 }
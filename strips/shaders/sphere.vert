@@ -1,13 +1,30 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 uv;
 
+struct Draw
+{
+    vec4 color;
+    vec2 vRange;
+};
+
+layout(std430, binding=0) buffer Draws
+{
+    Draw draws[];
+};
+
 out vec3 vs_position;
 out vec3 vs_normal;
 out vec2 vs_uv;
 out vec4 vs_positionInLightSpace;
+flat out vec3 vs_color;
+flat out vec2 vs_vRange;
+
+// the depth prepass runs this too, and has to land on exactly the same depths
+invariant gl_Position;
 
 uniform mat4 mvp;
 uniform mat4 modelMatrix;
@@ -23,5 +40,7 @@ void main(void)
     vs_positionInLightSpace = shadowMatrix * lightViewProjection * modelMatrix * vec4(position, 1.0);
     vs_normal = normalize(mat3(modelMatrix) * normal); // not quite...
     vs_uv = uv;
+    vs_color = draws[gl_DrawIDARB].color.rgb;
+    vs_vRange = draws[gl_DrawIDARB].vRange;
     gl_Position = mvp * vec4(position, 1.0);
 }
@@ -3,7 +3,7 @@
 #include "demo.h"
 #include "geometry.h"
 #include "shader_program.h"
-#include "shadow_buffer.h"
+#include "cascaded_shadow_map.h"
 #include "util.h"
 #include "tween.h"
 #include "buffer.h"
@@ -27,9 +27,9 @@ class Demo : public gl::demo
 public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
-        , hexagon_states_(GL_SHADER_STORAGE_BUFFER, GridRows * GridColumns)
-        , diamond_states_(GL_SHADER_STORAGE_BUFFER, (GridRows - 1) * (GridColumns - 1))
+        , shadow_map_(shadow_desc(CascadeSize, CascadeCount))
+        , hexagon_states_(GL_SHADER_STORAGE_BUFFER, GridRows * GridColumns, gl::buffer_storage::stream)
+        , diamond_states_(GL_SHADER_STORAGE_BUFFER, (GridRows - 1) * (GridColumns - 1), gl::buffer_storage::stream)
     {
         initialize_shader();
         initialize_geometry();
@@ -46,7 +46,7 @@ private:
 
         program_.add_shader(GL_VERTEX_SHADER, "shaders/tile.vert");
         program_.add_shader(GL_GEOMETRY_SHADER, "shaders/tile.geom");
-        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/tile.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/tile.frag", { "SHADOW_PCF_SIZE 3" });
         program_.link();
     }
 
@@ -104,48 +104,53 @@ private:
 
         update_buffers(model, x_offset);
 
-        // shadow
+        const auto projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
+        const auto camera_position = /* glm::vec3(0, 0, 7); */ glm::vec3(0, -6, 15);
+        const auto look_at = glm::vec3(0, 0, 0);
+        const auto view = glm::lookAt(camera_position, look_at, glm::vec3(0, 1, 0));
 
-        const auto light_projection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 50.0f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        // shadow
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
-        shadow_buffer_.bind();
+        const auto camera =
+                gl::camera_frustum{ view, glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f };
+        shadow_map_.update(camera, ShadowDistance, -light_position, SplitLambda);
 
-        glClear(GL_DEPTH_BUFFER_BIT);
+        glViewport(0, 0, shadow_map_.size(), shadow_map_.size());
 
         shadow_program_.bind();
-        shadow_program_.set_uniform("viewProjectionMatrix", light_projection * light_view);
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
         glDisable(GL_CULL_FACE);
-        draw_grid(shadow_program_, model, x_offset);
+
+        for (int i = 0; i < shadow_map_.cascade_count(); ++i)
+        {
+            shadow_map_.bind(i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            shadow_program_.set_uniform("viewProjectionMatrix", shadow_map_.cascade(i).view_projection);
+            draw_grid(shadow_program_, model, x_offset);
+        }
 
         glDisable(GL_POLYGON_OFFSET_FILL);
-        shadow_buffer_.unbind();
+        shadow_map_.unbind();
 
         // render
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0, 0, 0, 0);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
-        const auto camera_position = /* glm::vec3(0, 0, 7); */ glm::vec3(0, -6, 15);
-        const auto look_at = glm::vec3(0, 0, 0);
-        const auto view = glm::lookAt(camera_position, look_at, glm::vec3(0, 1, 0));
-
-        shadow_buffer_.bind_texture();
+        shadow_map_.bind_texture();
 
         program_.bind();
         program_.set_uniform("viewProjectionMatrix", projection * view);
         program_.set_uniform("lightPosition", light_position);
-        program_.set_uniform("lightViewProjection", light_projection * light_view);
-        program_.set_uniform("shadowMapTexture", 0);
+        program_.set_uniform("cascadeShadowTexture", 0);
+        shadow_map_.set_uniforms(program_);
 
         glEnable(GL_CULL_FACE);
         draw_grid(program_, model, x_offset);
@@ -240,8 +245,11 @@ private:
 
     static constexpr auto NumStrips = 3;
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    static constexpr auto CascadeSize = 1024; // unless -s says otherwise
+    static constexpr auto CascadeCount = 4;
+    static constexpr auto ShadowDistance = 40.0f;
+    // the nearest tiles are ~12 units away, so lean towards uniform splits
+    static constexpr auto SplitLambda = 0.3f;
 
     static constexpr auto GridRows = 12;
     static constexpr auto GridColumns = 15;
@@ -255,7 +263,7 @@ private:
     using Vertex = std::tuple<glm::vec2>;
     gl::geometry hexagon_;
     gl::geometry diamond_;
-    gl::shadow_buffer shadow_buffer_;
+    gl::cascaded_shadow_map shadow_map_;
     struct TileState {
         glm::mat4 transform;
         float height;
@@ -63,7 +63,7 @@ public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
     {
-        geometry_.set_data(std::vector<Vertex>(Edge::ControlPointCount * SegmentPoints));
+        geometry_.set_data(std::vector<Vertex>(Edge::ControlPointCount * SegmentPoints), gl::buffer_storage::stream);
 
         const auto v0 = glm::vec3(-1, -1, 1);
         const auto v1 = glm::vec3(-1, 1, 1);
@@ -92,7 +92,7 @@ public:
 
         initialize_shader();
 
-        blur_.reset(new blur_effect(width_, height_));
+        blur_.reset(new gl::blur_effect(width_, height_, GL_R11F_G11F_B10F));
     }
 
 private:
@@ -114,7 +114,7 @@ private:
         glDisable(GL_DEPTH_TEST);
         glDisable(GL_MULTISAMPLE);
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0, 0, 0, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -139,7 +139,7 @@ private:
         glEnable(GL_LINE_SMOOTH);
         glLineWidth(8.0);
 
-        const auto render_blurry = [this](const glm::vec4 &color, int num_passes) {
+        const auto render_blurry = [this](const glm::vec4 &color, float radius) {
             program_.set_uniform("color", color);
 
             blur_->bind();
@@ -149,20 +149,20 @@ private:
             render_scene();
             gl::framebuffer::unbind();
 
-            glViewport(0, 0, width_, height_);
-            blur_->render(width_, height_, num_passes);
+            glViewport(0, 0, render_width(), render_height());
+            blur_->render_glow(render_width(), render_height(), radius);
         };
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0.25, 0.25, 0.25, 1);
         glClear(GL_COLOR_BUFFER_BIT);
-        render_blurry(glm::vec4(1, 1, 1, 1), 1);
+        render_blurry(glm::vec4(1, 1, 1, 1), 4.0f);
 
 #if 0
         glLineWidth(2.0);
         program_.set_uniform("color", glm::vec4(1, 1, 1, 1));
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0.25, 0.25, 0.25, 1);
         glClear(GL_COLOR_BUFFER_BIT);
         render_scene();
@@ -196,8 +196,7 @@ private:
 
     void render_edge(const Edge &edge, int prev_state, int next_state, float t)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, geometry_.array_buffer_handle());
-        auto *verts = static_cast<Vertex *>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+        auto *verts = geometry_.map_vertices<Vertex>();
 
         for (int i = 0; i < Edge::ControlPointCount; ++i)
         {
@@ -216,7 +215,7 @@ private:
                 *verts++ = b.position(t);
             }
         }
-        glUnmapBuffer(GL_ARRAY_BUFFER);
+        geometry_.unmap_vertices();
         geometry_.bind();
         glDrawArrays(GL_LINE_STRIP, 0, Edge::ControlPointCount * SegmentPoints);
     }
@@ -238,7 +237,7 @@ private:
     gl::geometry geometry_;
     std::vector<Edge> edges_;
     gl::shader_program program_;
-    std::unique_ptr<blur_effect> blur_;
+    std::unique_ptr<gl::blur_effect> blur_;
 };
 
 int main(int argc, char *argv[])
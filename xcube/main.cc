@@ -5,6 +5,12 @@
 #include "shader_program.h"
 #include "util.h"
 #include "buffer.h"
+#include "weighted_oit.h"
+#include "reference_comparison.h"
+#include "instance_sort.h"
+#include "gpu_timer.h"
+#include "render_target_pool.h"
+#include "stats.h"
 
 #include "tween.h"
 
@@ -19,6 +25,8 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <random>
@@ -47,6 +55,15 @@ public:
         glDrawArraysInstanced(GL_TRIANGLES, 0, verts_.size(), instance_count);
     }
 
+    // every instance, in the order sort left them in
+    void render(const gl::instance_sort &sort) const
+    {
+        geometry_.bind();
+        sort.draw_arrays(GL_TRIANGLES);
+    }
+
+    int vertex_count() const { return verts_.size(); }
+
 private:
     void initialize_geometry()
     {
@@ -93,8 +110,11 @@ public:
     demo(int window_width, int window_height)
         : window_width_(window_width)
         , window_height_(window_height)
-        , states_(GL_SHADER_STORAGE_BUFFER, GridSize * GridSize * GridSize)
+        , states_(GL_SHADER_STORAGE_BUFFER, GridSize * GridSize * GridSize, gl::buffer_storage::stream)
         , cube_(new cube_geometry)
+        , sort_(GridSize * GridSize * GridSize, sizeof(entity_state), EntityPositionOffset)
+        , sort_timer_("instance sort us, gpu")
+        , comparison_("xcube")
     {
         initialize_shader();
 
@@ -103,6 +123,7 @@ public:
         std::uniform_real_distribution<float> distribution(0.5, 1.5);
 
         collapse_start_.resize(GridSize * GridSize * GridSize);
+        positions_.resize(GridSize * GridSize * GridSize);
         std::generate(collapse_start_.begin(), collapse_start_.end(), [&distribution, &generator] {
             return distribution(generator);
         });
@@ -110,20 +131,48 @@ public:
 
     void render_and_step(float dt)
     {
-        render(program_);
+        if (CompareWithReference)
+            comparison_.render(window_width_, window_height_, [this] { render(false); }, [this] { render(true); });
+        else
+            render(UseWeightedOit);
         cur_time_ += dt;
     }
 
 private:
+    // Fading cubes go through weighted blended OIT. Otherwise they're sorted back to
+    // front, which is the reference OIT is compared against.
+    static constexpr auto UseWeightedOit = true;
+    // radix sort the instances on the GPU rather than std::sort them on the CPU
+    static constexpr auto UseGpuSort = true;
+    // renders both ways every frame and reports the difference to gl::stats
+    static constexpr auto CompareWithReference = false;
+
     void initialize_shader()
     {
-        program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        opaque_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        opaque_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag", { "OPAQUE_PASS" });
+        opaque_program_.link();
+
+        program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert", { "SORTED_INSTANCES" });
         program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
         program_.link();
+
+        oit_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        oit_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag", gl::weighted_oit::shader_defines());
+        oit_program_.link();
     }
 
-    void render(const gl::shader_program &program) const
+    void render(bool weighted_oit) const
     {
+        const auto projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+        const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
+        const auto view_up = glm::vec3(0, 1, 0);
+        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
+
+        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
+        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1));
+
         update_grid_state();
 
         glViewport(0, 0, window_width_, window_height_);
@@ -139,25 +188,45 @@ private:
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
-        const auto view_up = glm::vec3(0, 1, 0);
-        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
-
-        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
-        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1));
-
-        program.bind();
-        program.set_uniform(program.uniform_location("modelMatrix"), model);
-        program.set_uniform(program.uniform_location("viewMatrix"), view);
-        program.set_uniform(program.uniform_location("projectionMatrix"), projection);
-        program.set_uniform(program.uniform_location("eyePosition"), view_pos);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, states_.handle());
 
-        glCullFace(GL_BACK);
+        const auto bind_program = [&](const gl::shader_program &program) {
+            program.bind();
+            program.set_uniform(program.uniform_location("modelMatrix"), model);
+            program.set_uniform(program.uniform_location("viewMatrix"), view);
+            program.set_uniform(program.uniform_location("projectionMatrix"), projection);
+            program.set_uniform(program.uniform_location("eyePosition"), view_pos);
+        };
+
+        bind_program(opaque_program_);
         cube_->render(GridSize * GridSize * GridSize);
+
+        if (weighted_oit) {
+            // OIT doesn't care about the order
+            oit_.begin(window_width_, window_height_);
+            bind_program(oit_program_);
+            cube_->render(GridSize * GridSize * GridSize);
+            oit_.end();
+        } else {
+            if (UseGpuSort) {
+                sort_timer_.begin();
+                sort_.sort(states_.handle(), GridSize * GridSize * GridSize, view * model, cube_->vertex_count());
+                sort_timer_.end();
+            } else {
+                const auto start = std::chrono::steady_clock::now();
+                sort_.sort_on_cpu(positions_, view * model, cube_->vertex_count());
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                gl::stats::add("instance sort us, cpu",
+                               std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+            }
+
+            glDepthMask(GL_FALSE);
+            bind_program(program_);
+            cube_->render(sort_);
+            glDepthMask(GL_TRUE);
+        }
     }
 
     void update_grid_state() const
@@ -209,6 +278,8 @@ private:
                     state->transform = translate_matrix * scale_matrix;
                     state->color = glm::vec4(diffuse_color, alpha);
                     ++state;
+
+                    positions_[index] = v;
                 }
             }
         }
@@ -224,14 +295,23 @@ private:
         glm::mat4 transform;
         glm::vec4 color;
     };
+    // the translation of transform
+    static constexpr auto EntityPositionOffset = offsetof(entity_state, transform) + 12 * sizeof(float);
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
-    gl::shader_program program_;
+    gl::shader_program opaque_program_;
+    gl::shader_program program_; // translucent instances, blended in order
+    gl::shader_program oit_program_;
     static_assert(sizeof(glm::mat4) == 16 * sizeof(float));
     gl::buffer<entity_state> states_;
     std::unique_ptr<cube_geometry> cube_;
     std::vector<float> collapse_start_;
+    mutable std::vector<glm::vec3> positions_; // for sorting on the CPU
+    gl::weighted_oit oit_;
+    gl::instance_sort sort_;
+    mutable gl::gpu_timer sort_timer_;
+    gl::reference_comparison comparison_;
 };
 
 int main()
@@ -266,6 +346,8 @@ int main()
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
             d.render_and_step(dt);
+            gl::render_targets().end_frame();
+            gl::stats::end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
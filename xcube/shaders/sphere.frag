@@ -1,5 +1,7 @@
 #version 450 core
 
+#include "weighted_oit.glsl"
+
 in vec3 vs_normal;
 in vec3 vs_position;
 in vec4 vs_color;
@@ -13,10 +15,17 @@ const vec3 light_color = vec3(1.0, 1.0, 1.0);
 const float kd = 0.5;
 const float ks = 0.5;
 
-out vec4 frag_color;
-
 void main(void)
 {
+    // fully opaque instances are drawn first, with depth writes, the others blended after
+#ifdef OPAQUE_PASS
+    if (vs_color.w < 1.0)
+        discard;
+#else
+    if (vs_color.w >= 1.0)
+        discard;
+#endif
+
     vec3 l = normalize(light_position - vs_position);
     float diffuse_light = max(dot(vs_normal, l), 0.0);
     vec3 diffuse = kd * diffuse_light * vs_color.xyz;
@@ -26,5 +35,5 @@ void main(void)
     if (diffuse_light <= 0.0)
         specular_light = 0.0;
     vec3 specular = ks * specular_light * light_color;
-    frag_color = vec4(ambient + diffuse + specular, vs_color.w);
+    writeTranslucent(vec4(ambient + diffuse + specular, vs_color.w));
 }
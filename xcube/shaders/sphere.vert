@@ -1,5 +1,9 @@
 #version 450 core
 
+#ifdef SORTED_INSTANCES
+#include "sorted_instances.glsl"
+#endif
+
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 uv;
@@ -25,9 +29,14 @@ out vec4 vs_color;
 
 void main(void)
 {
-    mat4 instanceModelMatrix = modelMatrix * states[gl_InstanceID].transform;
+#ifdef SORTED_INSTANCES
+    int instance = sortedInstance(gl_InstanceID);
+#else
+    int instance = gl_InstanceID;
+#endif
+    mat4 instanceModelMatrix = modelMatrix * states[instance].transform;
     vs_position = vec3(instanceModelMatrix * vec4(position, 1.0));
     vs_normal = normalize(mat3(instanceModelMatrix) * normal); // not quite correct
-    vs_color = states[gl_InstanceID].color;
+    vs_color = states[instance].color;
     gl_Position = projectionMatrix * viewMatrix * instanceModelMatrix * vec4(position, 1.0);
 }
@@ -24,7 +24,7 @@ class DonutGeometry
 public:
     DonutGeometry()
     {
-        geometry_.set_data(std::vector<Vertex>(VertexCount));
+        geometry_.set_data(std::vector<Vertex>(VertexCount), gl::buffer_storage::stream);
     }
 
     void render() const
@@ -35,8 +35,7 @@ public:
 
     void update_verts(float angle_offset, float u_offset) const
     {
-        glBindBuffer(GL_ARRAY_BUFFER, geometry_.array_buffer_handle());
-        auto *verts = static_cast<Vertex *>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+        auto *verts = geometry_.map_vertices<Vertex>();
 
         for (int i = 0; i < NumSegmentsOuter; ++i)
         {
@@ -85,7 +84,7 @@ public:
             }
         }
 
-        glUnmapBuffer(GL_ARRAY_BUFFER);
+        geometry_.unmap_vertices();
     }
 
 private:
@@ -142,7 +141,7 @@ private:
 
         // scene
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         // glClearColor(0.75, 0.75, 0.75, 0);
         glClearColor(0, 0, 0, 0);
 
@@ -206,7 +206,7 @@ private:
 
         // scene
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0.75, 0.75, 0.75, 0);
         // glClearColor(0.25, 0.25, 0.25, 0);
 
@@ -1,7 +1,8 @@
 #include <demo.h>
 #include <shader_program.h>
 #include <tween.h>
-#include <geometry.h>
+#include <geometry_arena.h>
+#include <render_queue.h>
 #include <shadow_buffer.h>
 
 #include <GL/glew.h>
@@ -16,12 +17,25 @@
 #include <random>
 #include <algorithm>
 
+using Vertex = std::tuple<glm::vec2>;
+using GeometryArena = gl::geometry_arena<Vertex>;
+
+// matches struct Draw in tile.geom/shadow.geom
+struct DrawData
+{
+    glm::mat4 model_matrix;
+};
+
+using RenderQueue = gl::render_queue<DrawData>;
+
 class Demo : public gl::demo
 {
 public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , arena_(TileVertices, TileVertices)
+        , queue_(GridRows * GridColumns, DrawDataBinding)
+        , shadow_buffer_(shadow_desc(ShadowSize))
     {
         initialize_shader();
         initialize_geometry();
@@ -38,7 +52,7 @@ private:
 
         program_.add_shader(GL_VERTEX_SHADER, "shaders/tile.vert");
         program_.add_shader(GL_GEOMETRY_SHADER, "shaders/tile.geom");
-        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/tile.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/tile.frag", { "SHADOW_PCF_SIZE 7" });
         program_.link();
     }
 
@@ -47,7 +61,6 @@ private:
         const auto m = 0.1;
         const auto a = 1 - m;
         const auto b = 0.5 - m;
-        using Vertex = std::tuple<glm::vec2>;
         const std::vector<Vertex> verts = {
             { glm::vec2(-a, b) },
             { glm::vec2(-b, b) },
@@ -62,7 +75,7 @@ private:
             { glm::vec2(-b, -b) },
             { glm::vec2(-a, -b) }
         };
-        tile_.set_data(verts);
+        tile_ = arena_.allocate(verts);
     }
 
     void initialize_flips()
@@ -118,7 +131,7 @@ private:
         const auto light_projection = glm::ortho(-15.0f, 15.0f, -15.0f, 15.0f, 1.0f, 50.0f);
         const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
+        glViewport(0, 0, shadow_buffer_.width(), shadow_buffer_.height());
         shadow_buffer_.bind();
 
         glClear(GL_DEPTH_BUFFER_BIT);
@@ -137,7 +150,7 @@ private:
 
         // render
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0, 0, 0, 0);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -152,7 +165,6 @@ private:
 
         program_.bind();
         program_.set_uniform("viewProjectionMatrix", projection * view);
-        program_.set_uniform("modelMatrix", model);
         program_.set_uniform("lightPosition", light_position);
         program_.set_uniform("lightViewProjection", light_projection * light_view);
         program_.set_uniform("shadowMapTexture", 0);
@@ -162,8 +174,6 @@ private:
 
     void draw_grid(const glm::mat4 &model, gl::shader_program &program)
     {
-        tile_.bind();
-
         float time = fmod(cur_time_, cycle_duration_);
 
         for (int i = 0; i < GridRows; ++i)
@@ -197,23 +207,28 @@ private:
                 glm::mat4 r0 = glm::rotate(glm::mat4(1.0), a, glm::vec3(1, 0, 0));
                 glm::mat4 r1 = glm::rotate(glm::mat4(1.0), static_cast<float>(animation.flop * 0.5 * M_PI), glm::vec3(0, 0, 1));
                 glm::mat4 ts = glm::translate(glm::mat4(1.0), glm::vec3(0, 0, h));
-                program.set_uniform("modelMatrix", model * t * ts * r1 * r0);
-                glDrawArrays(GL_LINE_LOOP, 0, 12);
+                queue_.push(arena_, GL_LINE_LOOP, program, tile_, DrawData{ model * t * ts * r1 * r0 });
             }
         }
+
+        queue_.submit();
     }
 
     static constexpr const auto GridColumns = 25;
     static constexpr const auto GridRows = 25;
     static constexpr const auto FlipDuration = 0.8f;
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    static constexpr auto ShadowSize = 2048; // unless -s says otherwise
+
+    static constexpr auto TileVertices = 12;
+    static constexpr auto DrawDataBinding = 0;
 
     float cur_time_ = 0.0f;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
-    gl::geometry tile_;
+    GeometryArena arena_;
+    RenderQueue queue_;
+    gl::geometry_handle tile_;
     gl::shadow_buffer shadow_buffer_;
     struct TileAnimation
     {
@@ -1,10 +1,13 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 layout(location=0) in vec2 position;
 
 out vec2 vs_position;
+flat out int vs_drawID;
 
 void main(void)
 {
     vs_position = position;
+    vs_drawID = gl_DrawIDARB;
 }
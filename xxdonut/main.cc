@@ -61,7 +61,7 @@ class DonutGeometry
 public:
     DonutGeometry()
     {
-        geometry_.set_data(std::vector<Vertex>(VertexCount));
+        geometry_.set_data(std::vector<Vertex>(VertexCount), gl::buffer_storage::stream);
     }
 
     void render() const
@@ -72,8 +72,7 @@ public:
 
     void update_verts(float small_radius, float big_radius, float angle_offset, float u_offset) const
     {
-        glBindBuffer(GL_ARRAY_BUFFER, geometry_.array_buffer_handle());
-        auto *verts = static_cast<Vertex *>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+        auto *verts = geometry_.map_vertices<Vertex>();
 
         for (int i = 0; i < NumSegmentsOuter; ++i)
         {
@@ -125,7 +124,7 @@ public:
             }
         }
 
-        glUnmapBuffer(GL_ARRAY_BUFFER);
+        geometry_.unmap_vertices();
     }
 
 private:
@@ -144,9 +143,9 @@ public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
         , plane_(glm::vec3(0, 0, 0), glm::vec3(50, 0, 0), glm::vec3(0, 0, 50))
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , shadow_buffer_(shadow_desc(ShadowSize))
     {
-        blur_.reset(new blur_effect(width_/4, height_/4));
+        blur_.reset(new gl::blur_effect(width_ / 4, height_ / 4, GL_R11F_G11F_B10F));
         initialize_shader();
     }
 
@@ -154,11 +153,11 @@ private:
     void initialize_shader()
     {
         donut_program_.add_shader(GL_VERTEX_SHADER, "shaders/donut.vert");
-        donut_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/donut.frag");
+        donut_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/donut.frag", { "SHADOW_PCF_SIZE 3" });
         donut_program_.link();
 
         plane_program_.add_shader(GL_VERTEX_SHADER, "shaders/plane.vert");
-        plane_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/plane.frag");
+        plane_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/plane.frag", { "SHADOW_PCF_SIZE 7" });
         plane_program_.link();
 
         shadow_program_.add_shader(GL_VERTEX_SHADER, "shaders/shadow.vert");
@@ -213,7 +212,7 @@ private:
 #endif
 
 #if 0
-        blur_->render(width_, height_, 4);
+        blur_->render(render_width(), render_height(), 4);
 #endif
 
         // shadow
@@ -221,7 +220,7 @@ private:
         const auto light_projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 50.0f);
         const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
+        glViewport(0, 0, shadow_buffer_.width(), shadow_buffer_.height());
         shadow_buffer_.bind();
 
         glClear(GL_DEPTH_BUFFER_BIT);
@@ -254,11 +253,11 @@ private:
 
         // scene
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         glClearColor(0.25, 0.25, 0.25, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        blur_->render(width_, height_, 8);
+        blur_->render(render_width(), render_height(), 8);
 
         glEnable(GL_DEPTH_TEST);
         draw_plane(plane_program_, viewProjection, model, light_position);
@@ -273,10 +272,10 @@ private:
         draw_scene(donut_program_, glm::vec3(0), viewProjection, model, light_position);
         gl::framebuffer::unbind();
 
-        glViewport(0, 0, width_, height_);
+        glViewport(0, 0, render_width(), render_height());
         draw_scene(donut_program_, glm::vec3(1), viewProjection, model, light_position);
 
-        blur_->render(width_, height_, 8);
+        blur_->render_glow(render_width(), render_height(), GlowRadius);
 #else
         draw_scene(donut_program_, glm::vec3(1), viewProjection, model);
 #endif
@@ -329,14 +328,16 @@ private:
     static constexpr float DonutRadius = 1.0f;
     static constexpr float DonutSmallRadius = 0.25f;
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    static constexpr auto ShadowSize = 2048; // unless -s says otherwise
+
+    // in quarter resolution texels, about as wide as the 8 Gaussian passes it replaces
+    static constexpr auto GlowRadius = 16.0f;
 
     float cur_time_ = 0;
     gl::shader_program donut_program_, plane_program_, shadow_program_;
     DonutGeometry geometry_;
     PlaneGeometry plane_;
-    std::unique_ptr<blur_effect> blur_;
+    std::unique_ptr<gl::blur_effect> blur_;
     gl::shadow_buffer shadow_buffer_;
 };
 
@@ -1,5 +1,7 @@
 #version 450 core
 
+#include "shadow_sampling.glsl"
+
 uniform sampler2DShadow shadowMapTexture;
 uniform vec3 lightPosition;
 uniform vec3 color;
@@ -13,29 +15,8 @@ out vec4 fragColor;
 
 float shadowFactor()
 {
-#if 0
-    float factor = textureProj(shadowMapTexture, vs_positionInLightSpace);
-#else
     vec3 projCoords = vs_positionInLightSpace.xyz / vs_positionInLightSpace.w;
-    vec2 uvCoords = projCoords.xy;
-
-    ivec2 texDim = textureSize(shadowMapTexture, 0).xy;
-    float xOffset = 1.0 / float(texDim.x);
-    float yOffset = 1.0 / float(texDim.y);
-
-    const float range = 5;
-    const float shadowFactor = 0.25;
-
-    float factor = 0.0;
-    for (float y = -range; y <= range; ++y)
-    {
-        for (float x = -range; x <= range; ++x)
-        {
-            factor += texture(shadowMapTexture, vec3(projCoords + vec3(x * xOffset, y * yOffset, 0)));
-        }
-    }
-    factor /= ((range * 2 + 1) * (range * 2 + 1));
-#endif
+    float factor = shadowFactor(shadowMapTexture, projCoords);
     return min(factor + 0.5, 1.0);
 }
 